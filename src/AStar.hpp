@@ -1,158 +1,559 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
-#include <iostream>
-#include <map>
+#include <limits>
 #include <memory>
-#include <unordered_map>
+#include <optional>
+#include <span>
+#include <vector>
 
 #include <glm/ext.hpp>
 
-#include "PathingNode.hpp"
+#include "Landmarks.hpp"
+#include "LineOfSight.hpp"
+#include "VisibilityGraph.hpp"
 
+//A* over a floor's visibility graph, with the start and the ends linked to
+//the vertecies they can see
+//nodes are numbered like the graph's vertecies, the start and then the ends
+//follow them, and live in flat arrays instead of one allocation each
+//the open list is a binary heap ordered by f and then by when a node was
+//last queued, so equal f come out first in first out
+//given Landmarks for the graph the heuristic is the larger of the straight
+//line and the landmark bound, which is as consistent, so the paths are as
+//short but fewer nodes are closed on the way
 class AStar
 {
+	static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+	//the landmarks a search bounds by, see bound_ends
+	static constexpr size_t active_landmarks = 2;
+
+	struct Node
+	{
+		double g = 0, h = 0, f = 0;
+		uint32_t parent = none;
+		//where in m_heap the node is while it is open
+		uint32_t heap_index = 0;
+		//bumped every time the node is queued, ties on f go to the lower
+		uint64_t queued = 0;
+	};
+
 	public:
+	//fills out[i] with whether segments[i] is unobstructed
+	using Visibility
+	    = std::function<void(std::span<const LineSegment>, std::span<bool>)>;
+
+	//the arrays a search works in, a later search handed the same buffers
+	//only resets them, so once they grew to the size of the graph it
+	//allocates nothing
+	struct Buffers
+	{
+		//the line of sight tests, visible(count) grows the results to hold
+		//count
+		std::vector<LineSegment> segments;
+		std::span<bool> visible(size_t count)
+		{
+			if (m_visible_size < count)
+			{
+				m_visible = std::make_unique<bool[]>(count);
+				m_visible_size = count;
+			}
+			return {m_visible.get(), count};
+		}
+
+		private:
+		friend class AStar;
+
+		std::unique_ptr<bool[]> m_visible;
+		size_t m_visible_size = 0;
+		std::vector<glm::dvec2> m_extra_positions;
+		//only the first 1 + ends are in use, the rest keep their capacity
+		std::vector<std::vector<size_t>> m_extra_neighbours;
+		std::vector<glm::dvec2> m_end_locations;
+		std::vector<double> m_landmark_bounds;
+		std::vector<std::pair<double, uint32_t>> m_active_landmarks;
+		std::vector<Node> m_nodes;
+		//a node is open or closed if its stamp is m_generation, so the
+		//arrays never have to be cleared for another search
+		std::vector<uint32_t> m_opened, m_closed;
+		uint32_t m_generation = 0;
+		std::vector<uint32_t> m_heap;
+	};
+
 	AStar(
 	    glm::dvec2 start,
 	    std::vector<glm::dvec2> ends,
-	    std::function<bool(glm::dvec2, glm::dvec2)> visibility,
-	    const std::vector<std::pair<glm::dvec2, std::vector<size_t>>>
-	        &visibility_map)
-	{
-		m_end_locations = ends;
-		m_visibility_map = visibility_map;
-		auto start_index = m_visibility_map.size();
-		std::vector<size_t> end_index;
-		m_visibility_map.emplace_back(start, std::vector<size_t>{});
-		end_offset = m_visibility_map.size();
-		for (auto end : ends)
+	    const Visibility &visibility,
+	    const VisibilityGraph &visibility_map,
+	    const Landmarks *landmarks = nullptr)
+	    : m_own_buffers(std::make_unique<Buffers>()),
+	      m_buffers(*m_own_buffers),
+	      m_visibility_map(visibility_map),
+	      m_landmarks(landmarks)
+	{
+		start_search(start, ends, visibility);
+	}
+	//works in buffers, which must outlive the search and not be used by
+	//another one meanwhile
+	AStar(
+	    Buffers &buffers,
+	    glm::dvec2 start,
+	    std::span<const glm::dvec2> ends,
+	    const Visibility &visibility,
+	    const VisibilityGraph &visibility_map,
+	    const Landmarks *landmarks = nullptr)
+	    : m_buffers(buffers),
+	      m_visibility_map(visibility_map),
+	      m_landmarks(landmarks)
+	{
+		start_search(start, ends, visibility);
+	}
+
+	bool run()
+	{
+		while (!stop)
+		{
+			if (m_reached != none)
+			{
+				return true;
+			}
+			if (m_heap.empty())
+			{
+				return false;
+			}
+			single_iteration();
+		}
+		return false;
+	}
+
+	std::optional<std::pair<std::vector<glm::dvec2>, size_t>>
+	path_result() const
+	{
+		std::vector<glm::dvec2> path;
+		auto end = path_result(path);
+		if (!end)
+		{
+			return std::nullopt;
+		}
+		return std::pair{std::move(path), *end};
+	}
+	//the same into path, which keeps its capacity, and the index of the end
+	std::optional<size_t> path_result(std::vector<glm::dvec2> &path) const
+	{
+		path.clear();
+		if (m_reached == none)
+		{
+			return std::nullopt;
+		}
+		for (auto node = m_reached; node != none; node = m_nodes[node].parent)
+		{
+			path.push_back(position_of(node));
+		}
+		std::reverse(path.begin(), path.end());
+		return m_reached - end_offset;
+	}
+
+	//the nodes closed so far
+	size_t expansions() const { return m_expansions; }
+
+	bool stop = false;
+
+	private:
+	//links the start and the ends and queues the start
+	void start_search(
+	    glm::dvec2 start,
+	    std::span<const glm::dvec2> ends,
+	    const Visibility &visibility)
+	{
+		m_end_locations.assign(ends.begin(), ends.end());
+		//the start and the ends are numbered after the graph's vertecies,
+		//their links are kept here instead of in a copy of the graph
+		auto vertex_count = m_visibility_map.size();
+		auto start_index = vertex_count;
+		end_offset = vertex_count + 1;
+		m_extra_positions.clear();
+		m_extra_positions.push_back(start);
+		m_extra_positions.insert(
+		    m_extra_positions.end(),
+		    ends.begin(),
+		    ends.end());
+		if (m_extra_neighbours.size() < 1 + ends.size())
+		{
+			m_extra_neighbours.resize(1 + ends.size());
+		}
+		for (auto &neighbours : m_extra_neighbours)
 		{
-			m_visibility_map.emplace_back(end, std::vector<size_t>{});
-			end_index.push_back(m_visibility_map.size() - 1);
+			neighbours.clear();
 		}
-		for (size_t i = 0; i < end_index[0]; i++)
+
+		//every start and end link is tested in one go, segment
+		//i * (1 + ends) is start -> i, followed by ends[end] -> i, and
+		//ends[end] -> start comes last
+		m_stride = 1 + ends.size();
+		auto &segments = m_buffers.segments;
+		segments.clear();
+		for (size_t i = 0; i < vertex_count; i++)
 		{
-			if (visibility(start, m_visibility_map[i].first) && i != start_index)
+			segments.push_back({start, m_visibility_map.position(i)});
+			for (auto end : ends)
 			{
-				m_visibility_map[start_index].second.push_back(i);
-				m_visibility_map[i].second.push_back(start_index);
+				segments.push_back({end, m_visibility_map.position(i)});
 			}
-			for (size_t end = 0; end < ends.size(); end++)
-				if (visibility(ends[end], m_visibility_map[i].first))
+		}
+		for (auto end : ends)
+		{
+			segments.push_back({end, start});
+		}
+		auto visible = m_buffers.visible(segments.size());
+		m_visible = visible.data();
+		visibility(segments, visible);
+
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			for (size_t link = 0; link < m_stride; link++)
+			{
+				if (m_visible[i * m_stride + link])
 				{
-					m_visibility_map[end_index[end]].second.push_back(i);
-					m_visibility_map[i].second.push_back(end_index[end]);
+					m_extra_neighbours[link].push_back(i);
 				}
+			}
+		}
+		for (size_t end = 0; end < ends.size(); end++)
+		{
+			if (m_visible[vertex_count * m_stride + end])
+			{
+				m_extra_neighbours[0].push_back(end_offset + end);
+				m_extra_neighbours[1 + end].push_back(start_index);
+			}
+		}
+
+		auto node_count = end_offset + ends.size();
+		if (m_nodes.size() < node_count)
+		{
+			m_nodes.resize(node_count);
+			m_opened.resize(node_count, 0);
+			m_closed.resize(node_count, 0);
+		}
+		//a wrapped stamp could match a node of a search long ago
+		if (++m_buffers.m_generation == 0)
+		{
+			std::fill(m_opened.begin(), m_opened.end(), 0);
+			std::fill(m_closed.begin(), m_closed.end(), 0);
+			m_buffers.m_generation = 1;
 		}
+		m_generation = m_buffers.m_generation;
+		bound_ends();
+		m_heap.clear();
+		open(start_index, none, 0);
+	}
 
-		m_ends = end_index;
-		auto start_candidate
-		    = std::make_shared<PathingNode>(start, ends, start_index);
-		m_f_open_nodes.insert({start_candidate->f, start_candidate});
-		m_pos_open_nodes.insert({start_index, start_candidate});
+	glm::dvec2 position_of(size_t index) const
+	{
+		return index < m_visibility_map.size()
+		           ? m_visibility_map.position(index)
+		           : m_extra_positions[index - m_visibility_map.size()];
 	}
 
-	bool run()
+	//what the landmarks tell about each end, for every landmark L the least
+	//and the most of d(L, u) + |u - end| and d(L, u) - |u - end| over the
+	//vertecies u that see the end
+	//a vertex v reaches the end through one of those u, so by the triangle
+	//inequality it is at least lo - d(L, v) and d(L, v) - hi away
+	//only the active_landmarks that bound the vertecies the start sees the
+	//furthest are asked during the search, taking the most of all of them
+	//costs more per node than the nodes it saves
+	void bound_ends()
 	{
-		while (!stop)
+		auto &bounds = m_buffers.m_landmark_bounds;
+		auto &active = m_buffers.m_active_landmarks;
+		bounds.clear();
+		active.clear();
+		if (!m_landmarks)
 		{
-			for (auto &end : m_ends)
+			return;
+		}
+		auto count = m_landmarks->count();
+		auto infinity = std::numeric_limits<double>::infinity();
+		auto vertex_count = m_visibility_map.size();
+		for (size_t end = 0; end < m_end_locations.size(); end++)
+		{
+			auto first = bounds.size();
+			for (size_t landmark = 0; landmark < count; landmark++)
+			{
+				bounds.push_back(infinity);
+				bounds.push_back(-infinity);
+			}
+			for (auto vertex : m_extra_neighbours[1 + end])
 			{
-				if (m_closed_nodes.find(end) != m_closed_nodes.end())
+				if (vertex >= vertex_count)
 				{
-					return true;
+					continue;
+				}
+				auto length = glm::distance(
+				    m_visibility_map.position(vertex),
+				    m_end_locations[end]);
+				auto distances = m_landmarks->distances(vertex);
+				for (size_t landmark = 0; landmark < count; landmark++)
+				{
+					//a vertex the landmark can't reach can't be reached
+					//from the ones it can either
+					if (distances[landmark] == infinity)
+					{
+						continue;
+					}
+					auto &lo = bounds[first + landmark * 2];
+					auto &hi = bounds[first + landmark * 2 + 1];
+					lo = std::min(lo, distances[landmark] + length);
+					hi = std::max(hi, distances[landmark] - length);
 				}
 			}
-			if (m_f_open_nodes.empty())
+		}
+
+		for (size_t landmark = 0; landmark < count; landmark++)
+		{
+			double score = 0;
+			for (auto vertex : m_extra_neighbours[0])
 			{
-				return false;
+				if (vertex < vertex_count)
+				{
+					score += bound_by(landmark, vertex);
+				}
 			}
-			single_iteration();
+			active.emplace_back(-score, static_cast<uint32_t>(landmark));
 		}
-		return false;
+		auto kept = std::min(active.size(), active_landmarks);
+		std::partial_sort(active.begin(), active.begin() + kept, active.end());
+		active.resize(kept);
+	}
+	//how far vertex is from the nearest end at least by one landmark
+	double bound_by(size_t landmark, size_t vertex) const
+	{
+		auto count = m_landmarks->count();
+		auto distance = m_landmarks->distances(vertex)[landmark];
+		if (distance == std::numeric_limits<double>::infinity())
+		{
+			return 0;
+		}
+		auto &bounds = m_buffers.m_landmark_bounds;
+		double nearest = std::numeric_limits<double>::infinity();
+		for (size_t end = 0; end < m_end_locations.size(); end++)
+		{
+			auto at = (end * count + landmark) * 2;
+			nearest = std::min(
+			    nearest,
+			    std::max(
+			        {0.0, bounds[at] - distance, distance - bounds[at + 1]}));
+		}
+		return nearest;
+	}
+	//how far vertex is from ends[end] at least by the landmarks, infinite if
+	//it can't reach it
+	double landmark_bound(size_t vertex, size_t end) const
+	{
+		auto distances = m_landmarks->distances(vertex);
+		auto bounds = &m_buffers.m_landmark_bounds[end * distances.size() * 2];
+		double bound = 0;
+		for (auto [score, landmark] : m_buffers.m_active_landmarks)
+		{
+			auto distance = distances[landmark];
+			if (distance == std::numeric_limits<double>::infinity())
+			{
+				continue;
+			}
+			bound = std::max(
+			    {bound,
+			     bounds[landmark * 2] - distance,
+			     distance - bounds[landmark * 2 + 1]});
+		}
+		return bound;
+	}
+	//the distance to the nearest end, in a straight line or by the
+	//landmarks, which know nothing of the start and the ends themselves
+	double heuristic(size_t index) const
+	{
+		auto position = position_of(index);
+		auto by_landmarks = m_landmarks && index < m_visibility_map.size();
+		double min = 1e100;
+		for (size_t end = 0; end < m_end_locations.size(); end++)
+		{
+			auto dist = glm::distance(position, m_end_locations[end]);
+			if (by_landmarks)
+			{
+				dist = std::max(dist, landmark_bound(index, end));
+			}
+			if (dist < min)
+			{
+				min = dist;
+			}
+		}
+		return min;
 	}
 
-	std::optional<std::pair<std::vector<glm::dvec2>, size_t>> path_result()
+	bool before(uint32_t a, uint32_t b) const
 	{
-		std::vector<glm::dvec2> reverse_result;
-		decltype(m_closed_nodes)::iterator end_iter;
-		for (auto &end : m_ends)
+		auto &first = m_nodes[a], &second = m_nodes[b];
+		return first.f < second.f
+		       || (first.f == second.f && first.queued < second.queued);
+	}
+	void place(size_t heap_index, uint32_t node)
+	{
+		m_heap[heap_index] = node;
+		m_nodes[node].heap_index = static_cast<uint32_t>(heap_index);
+	}
+	void sift_up(size_t heap_index)
+	{
+		auto node = m_heap[heap_index];
+		while (heap_index > 0)
 		{
-			auto attempt = m_closed_nodes.find(end);
-			if (attempt != m_closed_nodes.end())
+			auto parent = (heap_index - 1) / 2;
+			if (!before(node, m_heap[parent]))
 			{
-				end_iter = attempt;
 				break;
 			}
+			place(heap_index, m_heap[parent]);
+			heap_index = parent;
 		}
-		if (end_iter == m_closed_nodes.end())
+		place(heap_index, node);
+	}
+	void sift_down(size_t heap_index)
+	{
+		auto node = m_heap[heap_index];
+		while (true)
 		{
-			return std::nullopt;
+			auto child = heap_index * 2 + 1;
+			if (child >= m_heap.size())
+			{
+				break;
+			}
+			if (child + 1 < m_heap.size()
+			    && before(m_heap[child + 1], m_heap[child]))
+			{
+				child++;
+			}
+			if (!before(m_heap[child], node))
+			{
+				break;
+			}
+			place(heap_index, m_heap[child]);
+			heap_index = child;
 		}
-		auto end = end_iter->second.get();
-		while (end != nullptr)
+		place(heap_index, node);
+	}
+	uint32_t pop()
+	{
+		auto top = m_heap.front();
+		auto last = m_heap.back();
+		m_heap.pop_back();
+		if (!m_heap.empty())
 		{
-			reverse_result.push_back(end->position);
-			end = end->parent;
+			place(0, last);
+			sift_down(0);
 		}
-		return std::pair{
-		    std::vector<glm::dvec2>{
-		        reverse_result.rbegin(),
-		        reverse_result.rend()},
-		    end_iter->first - end_offset};
+		return top;
 	}
 
-	bool stop = false;
+	//queues a node seen for the first time
+	void open(size_t index, uint32_t parent, double length)
+	{
+		auto &node = m_nodes[index];
+		node.h = heuristic(index);
+		node.parent = parent;
+		node.g = parent == none ? 0 : length + m_nodes[parent].g;
+		node.f = node.g + node.h;
+		node.queued = m_queued++;
+		m_opened[index] = m_generation;
+		m_heap.push_back(static_cast<uint32_t>(index));
+		sift_up(m_heap.size() - 1);
+	}
 
-	private:
 	void single_iteration()
 	{
-		auto candidate = m_f_open_nodes.begin();
-		std::vector<size_t> new_candidates
-		    = m_visibility_map[candidate->second->index].second;
+		auto current = pop();
+		m_closed[current] = m_generation;
+		m_expansions++;
 
-		for (auto &new_candidate : new_candidates)
+		auto visit = [&](size_t new_candidate, double length) {
+			if (m_closed[new_candidate] == m_generation)
+			{
+				return;
+			}
+			if (m_opened[new_candidate] != m_generation)
+			{
+				open(new_candidate, current, length);
+				return;
+			}
+			auto &node = m_nodes[new_candidate];
+			if (length + m_nodes[current].g < node.g)
+			{
+				node.parent = current;
+				node.g = length + m_nodes[current].g;
+				node.f = node.g + node.h;
+				//goes behind the nodes of the same f, like a fresh one
+				node.queued = m_queued++;
+				sift_up(node.heap_index);
+				sift_down(node.heap_index);
+			}
+		};
+		auto vertex_count = m_visibility_map.size();
+		auto position = position_of(current);
+		if (current < vertex_count)
 		{
-			if (m_closed_nodes.contains(new_candidate))
+			//the graph's own edges first, then the links to the start and
+			//the ends, in the order a copy with them appended had
+			auto neighbours = m_visibility_map.neighbours(current);
+			auto lengths = m_visibility_map.lengths(current);
+			for (size_t k = 0; k < neighbours.size(); k++)
 			{
-				continue;
+				visit(neighbours[k], lengths[k]);
 			}
-			if (auto already = m_pos_open_nodes.find(new_candidate);
-			    already != m_pos_open_nodes.end())
+			for (size_t link = 0; link < m_stride; link++)
 			{
-				if (already->second->attempt_new_parent(candidate->second.get()))
+				if (m_visible[current * m_stride + link])
 				{
-					std::erase_if(m_f_open_nodes, [b = already->second](auto a) {
-						return a.second == b;
-					});
-					m_f_open_nodes.insert({already->second->f, already->second});
+					visit(
+					    vertex_count + link,
+					    glm::distance(position, m_extra_positions[link]));
 				}
 			}
-			else
+		}
+		else
+		{
+			for (auto neighbour : m_extra_neighbours[current - vertex_count])
 			{
-				auto constructed_candidate = std::make_shared<PathingNode>(
-				    candidate->second.get(),
-				    m_visibility_map[new_candidate].first,
-				    m_end_locations,
-				    new_candidate);
-				m_f_open_nodes.insert(
-				    {constructed_candidate->f, constructed_candidate});
-				m_pos_open_nodes.insert({new_candidate, constructed_candidate});
+				visit(neighbour, glm::distance(position, position_of(neighbour)));
 			}
 		}
-		m_closed_nodes.insert({candidate->second->index, candidate->second});
-		m_f_open_nodes.erase(candidate);
-		m_pos_open_nodes.erase(candidate->first);
+		if (current >= end_offset)
+		{
+			m_reached = current;
+		}
 	}
 
-	std::multimap<double, std::shared_ptr<PathingNode>> m_f_open_nodes;
-	std::unordered_map<size_t, std::shared_ptr<PathingNode>> m_pos_open_nodes;
-	std::unordered_map<size_t, std::shared_ptr<PathingNode>> m_closed_nodes;
+	std::unique_ptr<Buffers> m_own_buffers;
+	Buffers &m_buffers;
+	const VisibilityGraph &m_visibility_map;
+	const Landmarks *m_landmarks;
+	//the start and then the ends, and the vertecies they can see
+	std::vector<glm::dvec2> &m_extra_positions = m_buffers.m_extra_positions;
+	std::vector<std::vector<size_t>> &m_extra_neighbours
+	    = m_buffers.m_extra_neighbours;
+	//m_visible[i * m_stride] is whether vertex i sees the start,
+	//m_visible[i * m_stride + 1 + end] whether it sees ends[end]
+	const bool *m_visible = nullptr;
+	size_t m_stride = 0;
 
-	std::vector<std::pair<glm::dvec2, std::vector<size_t>>> m_visibility_map;
+	size_t end_offset = 0;
+	std::vector<glm::dvec2> &m_end_locations = m_buffers.m_end_locations;
 
-	size_t end_offset;
-	std::vector<glm::dvec2> m_end_locations;
-	std::vector<size_t> m_ends;
+	std::vector<Node> &m_nodes = m_buffers.m_nodes;
+	std::vector<uint32_t> &m_opened = m_buffers.m_opened;
+	std::vector<uint32_t> &m_closed = m_buffers.m_closed;
+	uint32_t m_generation = 0;
+	std::vector<uint32_t> &m_heap = m_buffers.m_heap;
+	uint64_t m_queued = 0;
+	size_t m_expansions = 0;
+	//the end that was closed first
+	uint32_t m_reached = none;
 };
@@ -0,0 +1,53 @@
+#include "BackgroundWorker.hpp"
+
+#include "ThreadPool.hpp"
+
+BackgroundWorker::BackgroundWorker() : m_thread([this] { loop(); }) {}
+
+BackgroundWorker::~BackgroundWorker()
+{
+	{
+		std::lock_guard lock{m_mutex};
+		m_stop = true;
+		m_tasks.clear();
+	}
+	m_wake.notify_all();
+	m_thread.join();
+}
+
+BackgroundWorker &BackgroundWorker::shared()
+{
+	//tasks split their loops over the shared pool, creating it first makes
+	//sure it is destroyed after this worker
+	ThreadPool::shared();
+	static BackgroundWorker worker;
+	return worker;
+}
+
+void BackgroundWorker::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard lock{m_mutex};
+		m_tasks.push_back(std::move(task));
+	}
+	m_wake.notify_one();
+}
+
+void BackgroundWorker::loop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock{m_mutex};
+			m_wake.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_stop)
+			{
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
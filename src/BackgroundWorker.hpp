@@ -0,0 +1,33 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//a single thread for work the caller should not wait for, tasks run one
+//at a time in the order they were submitted
+class BackgroundWorker
+{
+	public:
+	BackgroundWorker();
+	//finishes the running task, queued ones are dropped
+	~BackgroundWorker();
+	BackgroundWorker(const BackgroundWorker &) = delete;
+	BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+	//one worker for the whole program
+	static BackgroundWorker &shared();
+
+	void submit(std::function<void()> task);
+
+	private:
+	void loop();
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stop = false;
+	std::thread m_thread;
+};
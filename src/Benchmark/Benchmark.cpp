@@ -0,0 +1,1193 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "AStar.hpp"
+#include "world.hpp"
+
+//standalone timings of the geometry and line of sight code, run with
+//--help for the options
+//every floor is generated from a fixed seed, so runs on different versions
+//of the code measure exactly the same work
+
+//every allocation of the program, for the checks that something allocates
+//nothing
+std::atomic<size_t> allocations{0};
+
+namespace
+{
+//every form of new and delete is replaced, so all blocks come from malloc
+//and go back to free, aligned_alloc's included
+void *allocate(size_t size, std::align_val_t alignment) noexcept
+{
+	allocations++;
+	auto align = static_cast<size_t>(alignment);
+	size = size ? size : 1;
+	if (align <= alignof(std::max_align_t))
+	{
+		return std::malloc(size);
+	}
+	//aligned_alloc takes whole multiples of the alignment only
+	return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+void *allocate_or_throw(size_t size, std::align_val_t alignment)
+{
+	if (auto memory = allocate(size, alignment))
+	{
+		return memory;
+	}
+	throw std::bad_alloc{};
+}
+void deallocate(void *memory) noexcept { std::free(memory); }
+constexpr std::align_val_t default_alignment{
+    __STDCPP_DEFAULT_NEW_ALIGNMENT__};
+} // namespace
+
+void *operator new(size_t size)
+{
+	return allocate_or_throw(size, default_alignment);
+}
+void *operator new[](size_t size)
+{
+	return allocate_or_throw(size, default_alignment);
+}
+void *operator new(size_t size, std::align_val_t alignment)
+{
+	return allocate_or_throw(size, alignment);
+}
+void *operator new[](size_t size, std::align_val_t alignment)
+{
+	return allocate_or_throw(size, alignment);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size, default_alignment);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return allocate(size, default_alignment);
+}
+void *operator new(
+    size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t &) noexcept
+{
+	return allocate(size, alignment);
+}
+void *operator new[](
+    size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t &) noexcept
+{
+	return allocate(size, alignment);
+}
+
+void operator delete(void *memory) noexcept { deallocate(memory); }
+void operator delete[](void *memory) noexcept { deallocate(memory); }
+void operator delete(void *memory, size_t) noexcept { deallocate(memory); }
+void operator delete[](void *memory, size_t) noexcept { deallocate(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+	deallocate(memory);
+}
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+	deallocate(memory);
+}
+void operator delete(void *memory, size_t, std::align_val_t) noexcept
+{
+	deallocate(memory);
+}
+void operator delete[](void *memory, size_t, std::align_val_t) noexcept
+{
+	deallocate(memory);
+}
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+	deallocate(memory);
+}
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+	deallocate(memory);
+}
+void operator delete(
+    void *memory,
+    std::align_val_t,
+    const std::nothrow_t &) noexcept
+{
+	deallocate(memory);
+}
+void operator delete[](
+    void *memory,
+    std::align_val_t,
+    const std::nothrow_t &) noexcept
+{
+	deallocate(memory);
+}
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	size_t max_obstacles = 100000;
+	//recalc_visibility_graph is quadratic in the obstacle count
+	size_t max_graph_obstacles = 1000;
+	double min_seconds = 0.25;
+	std::string filter;
+};
+
+//keeps the compiler from dropping the work being timed
+size_t checksum = 0;
+//cross checks between implementations that failed
+size_t mismatches = 0;
+
+//an office: thin walls on a grid of rooms with desks in between
+Floor make_floor(size_t obstacle_count, uint64_t seed)
+{
+	Floor floor;
+	std::mt19937_64 rng{seed};
+	std::uniform_real_distribution<double> unit{0.0, 1.0};
+	auto rooms = std::max<size_t>(
+	    1,
+	    static_cast<size_t>(std::sqrt(obstacle_count / 8.0)));
+	double room = 1.0 / rooms;
+	for (size_t i = 0; i < obstacle_count; i++)
+	{
+		Obstacle obstacle;
+		if (i % 5 == 0)
+		{
+			//a wall along one side of a room, leaving space for a door
+			double line = static_cast<double>(rng() % rooms) * room;
+			double along = static_cast<double>(rng() % rooms) * room;
+			if (rng() % 2)
+			{
+				obstacle.position = {line, along};
+				obstacle.size = {room * 0.02, room * 0.7};
+			}
+			else
+			{
+				obstacle.position = {along, line};
+				obstacle.size = {room * 0.7, room * 0.02};
+			}
+		}
+		else
+		{
+			obstacle.position = {unit(rng), unit(rng)};
+			obstacle.size = {
+			    room * (0.05 + unit(rng) * 0.15),
+			    room * (0.05 + unit(rng) * 0.15)};
+			obstacle.rotation = unit(rng) * 2 * M_PI;
+			obstacle.blocks_infection = rng() % 4 != 0;
+		}
+		floor.obstacles.insert(obstacle);
+	}
+	floor.recalc();
+	return floor;
+}
+
+std::vector<LineSegment>
+make_segments(size_t count, double max_length, uint64_t seed)
+{
+	std::mt19937_64 rng{seed};
+	std::uniform_real_distribution<double> unit{0.0, 1.0};
+	std::vector<LineSegment> segments(count);
+	for (auto &segment : segments)
+	{
+		segment.from = {unit(rng), unit(rng)};
+		auto angle = unit(rng) * 2 * M_PI;
+		segment.to = segment.from
+		             + glm::dvec2{std::cos(angle), std::sin(angle)} * max_length
+		                   * unit(rng);
+	}
+	return segments;
+}
+
+//nanoseconds per call of body(i), doubling the number of calls until one
+//round takes at least min_seconds
+template <typename Body>
+std::pair<double, size_t> time_per_call(double min_seconds, Body &&body)
+{
+	size_t calls = 1;
+	while (true)
+	{
+		auto start = Clock::now();
+		for (size_t i = 0; i < calls; i++)
+		{
+			body(i);
+		}
+		std::chrono::duration<double> elapsed = Clock::now() - start;
+		if (elapsed.count() >= min_seconds || calls >= (size_t{1} << 40))
+		{
+			return {elapsed.count() * 1e9 / calls, calls};
+		}
+		calls *= 2;
+	}
+}
+
+class Benchmarks
+{
+	public:
+	explicit Benchmarks(Options options) : m_options(std::move(options)) {}
+
+	//per_call_work is what the per obstacle column divides by, the
+	//obstacles a single call has to consider
+	//returns the nanoseconds per call, 0 if the benchmark wasn't selected
+	template <typename Body>
+	double run(
+	    const std::string &name,
+	    size_t obstacle_count,
+	    size_t per_call_work,
+	    Body &&body)
+	{
+		if (!selected(name))
+		{
+			return 0;
+		}
+		auto [nanoseconds, calls]
+		    = time_per_call(m_options.min_seconds, std::forward<Body>(body));
+		std::printf(
+		    "%-36s %8zu %12zu %14.1f %14.3f\n",
+		    name.c_str(),
+		    obstacle_count,
+		    calls,
+		    nanoseconds,
+		    nanoseconds / std::max<size_t>(per_call_work, 1));
+		std::fflush(stdout);
+		return nanoseconds;
+	}
+
+	bool selected(const std::string &name) const
+	{
+		return m_options.filter.empty()
+		       || name.find(m_options.filter) != std::string::npos;
+	}
+
+	const Options &options() const { return m_options; }
+
+	private:
+	Options m_options;
+};
+
+void run_obstacle_benchmarks(Benchmarks &benchmarks, const Floor &floor)
+{
+	auto count = floor.obstacles.size();
+	std::vector<const Obstacle *> obstacles;
+	for (auto &obstacle : floor.obstacles)
+	{
+		obstacles.push_back(&obstacle);
+	}
+	auto segments = make_segments(4096, 0.05, 11);
+	auto obstacle_at = [&](size_t i) -> const Obstacle & {
+		return *obstacles[i % obstacles.size()];
+	};
+	auto segment_at = [&](size_t i) -> const LineSegment & {
+		return segments[i % segments.size()];
+	};
+
+	benchmarks.run("Obstacle::intersects(point)", count, 1, [&](size_t i) {
+		checksum += obstacle_at(i).intersects(segment_at(i).from);
+	});
+	benchmarks.run("Obstacle::intersects(segment)", count, 1, [&](size_t i) {
+		checksum += obstacle_at(i).intersects(segment_at(i).from, segment_at(i).to);
+	});
+	benchmarks.run(
+	    "Obstacle::intersects(segment, 0.011)",
+	    count,
+	    1,
+	    [&](size_t i) {
+		    checksum += obstacle_at(i).intersects(
+		        segment_at(i).from,
+		        segment_at(i).to,
+		        0.011);
+	    });
+	benchmarks.run(
+	    "Obstacle::intersects(segment, 0.005)",
+	    count,
+	    1,
+	    [&](size_t i) {
+		    checksum += obstacle_at(i).intersects(
+		        segment_at(i).from,
+		        segment_at(i).to,
+		        0.005);
+	    });
+	benchmarks.run("Obstacle::intersects(obstacle)", count, 1, [&](size_t i) {
+		checksum += obstacle_at(i).intersects(obstacle_at(i * 7 + 1));
+	});
+	benchmarks.run("Obstacle::get_vertecies(0.011)", count, 1, [&](size_t i) {
+		checksum += obstacle_at(i).get_vertecies(0.011).size();
+	});
+	benchmarks.run("Obstacle::get_vertecies(0.005)", count, 1, [&](size_t i) {
+		checksum += obstacle_at(i).get_vertecies(0.005).size();
+	});
+}
+
+double path_length(const std::vector<glm::dvec2> &path)
+{
+	double length = 0;
+	for (size_t i = 1; i < path.size(); i++)
+	{
+		length += glm::distance(path[i - 1], path[i]);
+	}
+	return length;
+}
+
+//a path and the index of the end it reaches, as AStar::path_result gives it
+using FoundPath = std::optional<std::pair<std::vector<glm::dvec2>, size_t>>;
+
+//find(start) is another way to AStar's paths, returning a FoundPath, it has
+//to find a path exactly as short from every start or none where AStar finds
+//none
+//returns the nodes AStar closed, to compare searches with
+template <typename Find>
+size_t check_against_astar(
+    const char *name,
+    std::span<const LineSegment> starts,
+    const std::vector<glm::dvec2> &ends,
+    const AStar::Visibility &visibility,
+    const VisibilityGraph &graph,
+    Find &&find)
+{
+	size_t expansions = 0;
+	for (auto &segment : starts)
+	{
+		AStar pather{segment.from, ends, visibility, graph};
+		pather.run();
+		expansions += pather.expansions();
+		auto expected = pather.path_result();
+		auto path = find(segment.from);
+		if (expected.has_value() != path.has_value()
+		    || (path
+		        && std::abs(path_length(path->first)
+		                    - path_length(expected->first))
+		               > 1e-9))
+		{
+			std::printf("%s path differs from AStar's\n", name);
+			mismatches++;
+			break;
+		}
+	}
+	return expansions;
+}
+
+void run_floor_benchmarks(Benchmarks &benchmarks, Floor &floor)
+{
+	auto count = floor.obstacles.size();
+	auto short_segments = make_segments(4096, 0.05, 21);
+	auto long_segments = make_segments(4096, 1.5, 22);
+
+	struct Case
+	{
+		const char *name;
+		const std::vector<LineSegment> *segments;
+		bool movement;
+		bool infection;
+		double expand;
+	};
+	for (auto [name, segments, movement, infection, expand] : {
+	         Case{"test_line_of_sight short", &short_segments, true, false, 0},
+	         Case{"test_line_of_sight long", &long_segments, true, false, 0},
+	         Case{"test_line_of_sight long infection",
+	              &long_segments,
+	              false,
+	              true,
+	              0},
+	         Case{"test_line_of_sight short wander",
+	              &short_segments,
+	              true,
+	              false,
+	              0.02}})
+	{
+		benchmarks.run(name, count, count, [&](size_t i) {
+			auto &segment = (*segments)[i % segments->size()];
+			checksum += floor.test_line_of_sight(
+			    segment.from,
+			    segment.to,
+			    movement,
+			    infection,
+			    expand);
+		});
+	}
+
+	auto out = std::make_unique<bool[]>(long_segments.size());
+	benchmarks.run(
+	    "test_line_of_sight_batch long x4096",
+	    count,
+	    count * long_segments.size(),
+	    [&](size_t) {
+		    floor.test_line_of_sight_batch(
+		        long_segments,
+		        {.movement = true},
+		        {out.get(), long_segments.size()});
+		    checksum += out[0];
+	    });
+
+	if (count <= benchmarks.options().max_graph_obstacles)
+	{
+		benchmarks.run("recalc_visibility_graph", count, count, [&](size_t) {
+			floor.recalc();
+			checksum += floor.recalc_visibility_graph().size();
+		});
+		auto pairwise = floor.recalc_visibility_graph();
+
+		floor.set_visibility_graph_pruning(true);
+		benchmarks.run(
+		    "recalc_visibility_graph pruned",
+		    count,
+		    count,
+		    [&](size_t) {
+			    floor.recalc();
+			    checksum += floor.recalc_visibility_graph().size();
+		    });
+		auto pruned = floor.recalc_visibility_graph();
+		floor.set_visibility_graph_pruning(false);
+
+		//pruning only ever drops edges
+		for (size_t i = 0; i < pairwise.size(); i++)
+		{
+			if (!std::ranges::includes(
+			        pairwise.neighbours(i),
+			        pruned.neighbours(i)))
+			{
+				std::printf("pruned graph has edges the full graph lacks\n");
+				mismatches++;
+				break;
+			}
+		}
+		//an edit patches the graph, it has to come out as a rebuild would
+		auto edited = floor.obstacles.begin();
+		for (size_t i = 0; i < count / 2; i++)
+		{
+			++edited;
+		}
+		auto home = edited->position;
+		auto move_edited = [&](glm::dvec2 position) -> const VisibilityGraph & {
+			auto &obstacle = floor.obstacles[edited.id()];
+			obstacle.position = position;
+			obstacle.invalidate_geometry();
+			floor.obstacle_changed(edited.id());
+			return floor.recalc_visibility_graph();
+		};
+		floor.recalc_visibility_graph();
+		benchmarks.run("update_visibility_graph", count, count, [&](size_t i) {
+			auto offset = glm::dvec2{0.002 * (i % 16), 0.001 * (i % 8)};
+			checksum += move_edited(home + offset).edge_count();
+		});
+		for (bool pruning : {false, true})
+		{
+			floor.set_visibility_graph_pruning(pruning);
+			floor.recalc_visibility_graph();
+			auto offset = glm::dvec2{pruning ? -0.02 : 0.03, 0.03};
+			auto updated = move_edited(home + offset);
+			floor.recalc();
+			if (floor.recalc_visibility_graph() != updated)
+			{
+				std::printf("updated visibility graph differs from a rebuild\n");
+				mismatches++;
+			}
+		}
+		floor.set_visibility_graph_pruning(false);
+		floor.recalc_visibility_graph();
+		//a removed obstacle's slot goes to the next insert, under a new id
+		auto old_id = edited.id();
+		auto replacement = *edited;
+		replacement.position = home + glm::dvec2{0.03, -0.02};
+		replacement.invalidate_geometry();
+		floor.obstacles.erase(old_id);
+		floor.obstacle_changed(old_id);
+		auto new_id = floor.obstacles.insert(replacement);
+		floor.obstacle_changed(new_id);
+		auto reused = floor.recalc_visibility_graph();
+		floor.recalc();
+		if (floor.obstacles.contains(old_id) || new_id == old_id
+		    || ObstacleStore::slot_of(new_id) != ObstacleStore::slot_of(old_id)
+		    || floor.recalc_visibility_graph() != reused)
+		{
+			std::printf("a reused obstacle slot went wrong\n");
+			mismatches++;
+		}
+		move_edited(home);
+		auto graph = floor.visibility_graph_snapshot(true);
+		auto visibility = [&](
+		                      std::span<const LineSegment> segments,
+		                      std::span<bool> out) {
+			floor.test_line_of_sight_batch(segments, {.movement = true}, out);
+		};
+		std::vector<glm::dvec2> ends{long_segments[0].to, long_segments[1].to};
+		auto starts = std::span<const LineSegment>{long_segments}.first(64);
+		auto plain_time = benchmarks.run(
+		    "AStar long x2 ends",
+		    count,
+		    count,
+		    [&](size_t i) {
+			    AStar pather{
+			        long_segments[i % 64].from,
+			        ends,
+			        visibility,
+			        *graph};
+			    pather.run();
+			    auto path = pather.path_result();
+			    checksum += path ? path->first.size() : 0;
+		    });
+		benchmarks.run("FlowField build x2 ends", count, count, [&](size_t) {
+			FlowField field{graph, ends, visibility};
+			checksum += field.memory_bytes();
+		});
+		FlowField field{graph, ends, visibility};
+		benchmarks.run(
+		    "FlowField::find_path long x2 ends",
+		    count,
+		    count,
+		    [&](size_t i) {
+			    auto path = field.find_path(long_segments[i % 64].from, visibility);
+			    checksum += path ? path->first.size() : 0;
+		    });
+		//a field has to find paths exactly as short as AStar does
+		check_against_astar(
+		    "flow field",
+		    starts,
+		    ends,
+		    visibility,
+		    *graph,
+		    [&](glm::dvec2 start) {
+			    return field.find_path(start, visibility);
+		    });
+
+		benchmarks.run("Landmarks build x8", count, count, [&](size_t) {
+			Landmarks landmarks{graph, 8};
+			checksum += landmarks.memory_bytes();
+		});
+		Landmarks landmarks{graph, 8};
+		auto landmark_time = benchmarks.run(
+		    "AStar long x2 ends landmarks",
+		    count,
+		    count,
+		    [&](size_t i) {
+			    AStar pather{
+			        long_segments[i % 64].from,
+			        ends,
+			        visibility,
+			        *graph,
+			        &landmarks};
+			    pather.run();
+			    auto path = pather.path_result();
+			    checksum += path ? path->first.size() : 0;
+		    });
+		//the same searches with the line of sight tests answered from a
+		//record, which leaves the part the landmarks can speed up
+		std::vector<std::vector<char>> recorded(64);
+		size_t replaying = 0;
+		AStar::Visibility replay = [&](
+		                               std::span<const LineSegment> segments,
+		                               std::span<bool> out) {
+			auto &record = recorded[replaying];
+			if (record.empty())
+			{
+				visibility(segments, out);
+				record.assign(out.begin(), out.end());
+				return;
+			}
+			std::copy(record.begin(), record.end(), out.begin());
+		};
+		//recorded before the timing starts, a run may only call a few
+		for (replaying = 0; replaying < recorded.size(); replaying++)
+		{
+			AStar{long_segments[replaying].from, ends, replay, *graph};
+		}
+		std::array<double, 2> search_times{};
+		for (auto with_landmarks : {false, true})
+		{
+			search_times[with_landmarks] = benchmarks.run(
+			    with_landmarks ? "AStar search x2 ends landmarks"
+			                   : "AStar search x2 ends",
+			    count,
+			    count,
+			    [&](size_t i) {
+				    replaying = i % 64;
+				    AStar pather{
+				        long_segments[replaying].from,
+				        ends,
+				        replay,
+				        *graph,
+				        with_landmarks ? &landmarks : nullptr};
+				    pather.run();
+				    checksum += pather.expansions();
+			    });
+		}
+
+		//the landmark bound may only make the search close fewer nodes, the
+		//paths have to be as short
+		size_t landmark_expansions = 0;
+		auto plain_expansions = check_against_astar(
+		    "landmark",
+		    starts,
+		    ends,
+		    visibility,
+		    *graph,
+		    [&](glm::dvec2 start) {
+			    AStar bounded{start, ends, visibility, *graph, &landmarks};
+			    bounded.run();
+			    landmark_expansions += bounded.expansions();
+			    return bounded.path_result();
+		    });
+		if (benchmarks.selected("AStar long x2 ends landmarks"))
+		{
+			std::printf(
+			    "%-36s %8zu %12zu %14zu\n",
+			    "astar expansions, landmarks",
+			    count,
+			    plain_expansions / 64,
+			    landmark_expansions / 64);
+			//the expansions saved have to pay for the bound
+			std::printf(
+			    "%-36s %8zu %12.1f %14.1f\n",
+			    "astar ns, landmarks",
+			    count,
+			    plain_time,
+			    landmark_time);
+			std::printf(
+			    "%-36s %8zu %12.1f %14.1f\n",
+			    "astar search ns, landmarks",
+			    count,
+			    search_times[0],
+			    search_times[1]);
+			std::printf(
+			    "%-36s %8zu %12zu %14zu\n",
+			    "landmark bytes, graph bytes",
+			    count,
+			    landmarks.memory_bytes(),
+			    graph->memory_bytes());
+		}
+
+		//only the sizes RouteTableCache builds tables for by default
+		if (graph->size() <= RouteTableCache::Settings{}.max_vertecies)
+		{
+			benchmarks.run("RouteTable build", count, count, [&](size_t) {
+				RouteTable table{graph};
+				checksum += table.memory_bytes();
+			});
+			RouteTable table{graph};
+			std::vector<glm::dvec2> path;
+			auto table_path = [&](glm::dvec2 start) {
+				return table.find_path(start, ends, visibility, path);
+			};
+			benchmarks.run(
+			    "RouteTable::find_path long x2 ends",
+			    count,
+			    count,
+			    [&](size_t i) {
+				    table_path(long_segments[i % 64].from);
+				    checksum += path.size();
+			    });
+			//a short trip only has to test the few links near it, AStar
+			//tests every vertex
+			benchmarks.run("AStar short", count, count, [&](size_t i) {
+				auto &segment = short_segments[i % 64];
+				AStar pather{segment.from, {segment.to}, visibility, *graph};
+				pather.run();
+				auto path = pather.path_result();
+				checksum += path ? path->first.size() : 0;
+			});
+			benchmarks.run(
+			    "RouteTable::find_path short",
+			    count,
+			    count,
+			    [&](size_t i) {
+				    auto &segment = short_segments[i % 64];
+				    table.find_path(
+				        segment.from,
+				        {&segment.to, 1},
+				        visibility,
+				        path);
+				    checksum += path.size();
+			    });
+			for (auto &segment : std::span{short_segments}.first(64))
+			{
+				AStar pather{segment.from, {segment.to}, visibility, *graph};
+				pather.run();
+				auto expected = pather.path_result();
+				auto end = table.find_path(
+				    segment.from,
+				    {&segment.to, 1},
+				    visibility,
+				    path);
+				if (expected.has_value() != end.has_value()
+				    || (end
+				        && std::abs(path_length(path)
+				                    - path_length(expected->first))
+				               > 1e-9))
+				{
+					std::printf("short route table path differs from AStar's\n");
+					mismatches++;
+					break;
+				}
+			}
+			check_against_astar(
+			    "route table",
+			    starts,
+			    ends,
+			    visibility,
+			    *graph,
+			    [&](glm::dvec2 start) -> FoundPath {
+				    auto end = table_path(start);
+				    if (!end)
+				    {
+					    return std::nullopt;
+				    }
+				    return std::pair{path, *end};
+			    });
+			if (benchmarks.selected("RouteTable build"))
+			{
+				std::printf(
+				    "%-36s %8zu %12zu %14zu\n",
+				    "route table vertecies, bytes",
+				    count,
+				    table.size(),
+				    table.memory_bytes());
+			}
+		}
+
+		if (benchmarks.selected("recalc_visibility_graph pruned"))
+		{
+			std::printf(
+			    "%-36s %8zu %12zu %14zu\n",
+			    "visibility graph edges, pruned",
+			    count,
+			    pairwise.edge_count(),
+			    pruned.edge_count());
+			std::printf(
+			    "%-36s %8zu %12zu %14zu\n",
+			    "visibility graph bytes, pruned",
+			    count,
+			    pairwise.memory_bytes(),
+			    pruned.memory_bytes());
+		}
+	}
+
+	benchmarks.run("NavMesh::build", count, count, [&](size_t) {
+		floor.recalc();
+		checksum += floor.get_nav_mesh().triangle_count();
+	});
+	auto &mesh = floor.get_nav_mesh();
+	benchmarks.run("NavMesh::find_path long", count, count, [&](size_t i) {
+		auto &segment = long_segments[i % long_segments.size()];
+		auto path = mesh.find_path(segment.from, {&segment.to, 1});
+		checksum += path ? path->first.size() : 0;
+	});
+	if (count <= benchmarks.options().max_graph_obstacles
+	    && benchmarks.selected("NavMesh::find_path long"))
+	{
+		//the mesh keeps the whole margin, so its paths have to be clear
+		//where the visibility graph's are, apart from the steps out of an
+		//obstacle at either end
+		for (auto &segment : long_segments)
+		{
+			auto path = mesh.find_path(segment.from, {&segment.to, 1});
+			if (!path)
+			{
+				continue;
+			}
+			auto &corners = path->first;
+			for (size_t i = 1; i + 2 < corners.size(); i++)
+			{
+				if (!floor.test_line_of_sight(
+				        corners[i],
+				        corners[i + 1],
+				        true,
+				        false,
+				        0))
+				{
+					std::printf("navmesh path crosses an obstacle\n");
+					mismatches++;
+					break;
+				}
+			}
+		}
+	}
+	if (benchmarks.selected("NavMesh::build"))
+	{
+		std::printf(
+		    "%-36s %8zu %12zu %14zu\n",
+		    "navmesh triangles, bytes",
+		    count,
+		    mesh.triangle_count(),
+		    mesh.memory_bytes());
+	}
+}
+
+//path queries on a world of two floors joined by floor changers
+void run_world_benchmarks(Benchmarks &benchmarks, const Floor &floor)
+{
+	auto count = floor.obstacles.size();
+	if (count > benchmarks.options().max_graph_obstacles)
+	{
+		return;
+	}
+	World world;
+	for (int index : {0, 1})
+	{
+		world.add_floor(index);
+		for (auto &obstacle : floor.obstacles)
+		{
+			world.add_obstacle(index, obstacle);
+		}
+	}
+	for (auto corner : {glm::dvec2{0.01, 0.01}, glm::dvec2{0.99, 0.99}})
+	{
+		world.add_floor_changer({{0, corner}, {1, corner}});
+	}
+	world.recalc_visibility_graphs();
+	auto segments = make_segments(64, 1.5, 23);
+
+	PathResult result;
+	benchmarks.run("World::calculate_path long", count, count, [&](size_t i) {
+		auto &segment = segments[i % segments.size()];
+		world.calculate_path(0, segment.from, 0, segment.to, result);
+		checksum += result.waypoints.size();
+	});
+	benchmarks.run(
+	    "World::calculate_path across floors",
+	    count,
+	    count,
+	    [&](size_t i) {
+		    auto &segment = segments[i % segments.size()];
+		    world.calculate_path(0, segment.from, 1, segment.to, result);
+		    checksum += result.waypoints.size();
+	    });
+
+	//once the buffers have grown, queries like earlier ones allocate
+	//nothing
+	size_t allocated = 0;
+	for (size_t round = 0; round < 2; round++)
+	{
+		auto before = allocations.load();
+		for (auto &segment : segments)
+		{
+			for (int to_floor : {0, 1})
+			{
+				world.calculate_path(
+				    0,
+				    segment.from,
+				    to_floor,
+				    segment.to,
+				    result);
+				checksum += result.waypoints.size();
+			}
+		}
+		allocated = allocations - before;
+	}
+	if (allocated != 0)
+	{
+		std::printf("path queries allocated %zu times\n", allocated);
+		mismatches++;
+	}
+
+	//a batch, every query twice, finds exactly the paths it would one at a
+	//time, in whatever order the queries come
+	std::vector<PathQuery> queries;
+	std::vector<PathResult> batch_results(segments.size() * 4);
+	for (size_t i = 0; i < batch_results.size(); i++)
+	{
+		auto &segment = segments[i / 4];
+		int to_floor = i % 2;
+		queries.push_back(
+		    {0, segment.from, to_floor, segment.to, &batch_results[i]});
+	}
+	auto batch_matches = [&] {
+		for (auto &query : queries)
+		{
+			world.calculate_path(
+			    query.from_floor,
+			    query.from,
+			    query.to_floor,
+			    query.to,
+			    result);
+			if (result.waypoints != query.result->waypoints
+			    || result.force_teleport != query.result->force_teleport)
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+	world.calculate_paths(queries);
+	bool batch_correct = batch_matches();
+	std::ranges::reverse(queries);
+	world.calculate_paths(queries);
+	if (!batch_correct || !batch_matches())
+	{
+		std::printf("batched paths differ from single queries\n");
+		mismatches++;
+	}
+	benchmarks.run(
+	    "World::calculate_path x256",
+	    count,
+	    count * queries.size(),
+	    [&](size_t) {
+		    for (auto &query : queries)
+		    {
+			    world.calculate_path(
+			        query.from_floor,
+			        query.from,
+			        query.to_floor,
+			        query.to,
+			        *query.result);
+		    }
+		    checksum += queries.front().result->waypoints.size();
+	    });
+	benchmarks.run(
+	    "World::calculate_paths x256",
+	    count,
+	    count * queries.size(),
+	    [&](size_t) {
+		    world.calculate_paths(queries);
+		    checksum += queries.front().result->waypoints.size();
+	    });
+
+	//the cached paths go by the vertecies nearest to both ends, but they
+	//have to be walkable and end where they were asked to
+	auto walkable = [&](int from_floor,
+	                    glm::dvec2 from,
+	                    int to_floor,
+	                    glm::dvec2 to,
+	                    const PathResult &path) {
+		if (path.force_teleport || path.waypoints.empty())
+		{
+			return true;
+		}
+		auto floor = from_floor;
+		auto at = from;
+		for (auto &waypoint : path.waypoints)
+		{
+			if (waypoint.index() == 1)
+			{
+				std::tie(floor, at) = std::get<1>(waypoint);
+				continue;
+			}
+			auto next = std::get<0>(waypoint);
+			if (!world.test_line_of_sight(floor, at, next, true, false))
+			{
+				return false;
+			}
+			at = next;
+		}
+		return floor == to_floor && at == to;
+	};
+	auto path_length = [](glm::dvec2 from, const PathResult &path) {
+		double length = 0;
+		for (auto &waypoint : path.waypoints)
+		{
+			if (waypoint.index() == 0)
+			{
+				length += glm::distance(from, std::get<0>(waypoint));
+				from = std::get<0>(waypoint);
+			}
+			else
+			{
+				from = std::get<1>(waypoint).second;
+			}
+		}
+		return length;
+	};
+	std::vector<double> uncached_lengths;
+	for (auto &segment : segments)
+	{
+		for (int to_floor : {0, 1})
+		{
+			world.calculate_path(0, segment.from, to_floor, segment.to, result);
+			uncached_lengths.push_back(
+			    result.force_teleport ? 0 : path_length(segment.from, result));
+		}
+	}
+	//the trips the cached runs repeat, planned every time
+	auto trip = [&](size_t i) {
+		auto &segment = segments[i / 2 % segments.size()];
+		world.calculate_path(0, segment.from, i % 2, segment.to, result);
+		checksum += result.waypoints.size();
+	};
+	benchmarks.run("World::calculate_path trips", count, count, trip);
+
+	//by default only paths as short as planned ones are handed out, longer
+	//ones have to be asked for
+	PathCache::Stats stats;
+	for (auto [name, max_detour] :
+	     {std::pair{"World::calculate_path trips cached",
+	                PathCache::Settings{}.max_detour},
+	      std::pair{"World::calculate_path trips x1.25", 1.25}})
+	{
+		world.set_path_cache_settings(
+		    {.enabled = true, .max_detour = max_detour});
+		world.reset_path_cache_stats();
+		double longest_detour = 0;
+		for (size_t round = 0; round < 2; round++)
+		{
+			auto before = allocations.load();
+			size_t i = 0;
+			for (auto &segment : segments)
+			{
+				for (int to_floor : {0, 1})
+				{
+					world.calculate_path(
+					    0,
+					    segment.from,
+					    to_floor,
+					    segment.to,
+					    result);
+					if (!walkable(0, segment.from, to_floor, segment.to, result))
+					{
+						std::printf("cached path is not walkable\n");
+						mismatches++;
+					}
+					if (uncached_lengths[i] > 0)
+					{
+						longest_detour = std::max(
+						    longest_detour,
+						    path_length(segment.from, result)
+						        / uncached_lengths[i]);
+					}
+					i++;
+				}
+			}
+			allocated = allocations - before;
+		}
+		if (allocated != 0)
+		{
+			std::printf("cached path queries allocated %zu times\n", allocated);
+			mismatches++;
+		}
+		//the joins are checked against a lower bound of the shortest path
+		if (longest_detour > max_detour + 1e-9)
+		{
+			std::printf("cached path is longer than max_detour allows\n");
+			mismatches++;
+		}
+		//every trip is cached by now
+		benchmarks.run(name, count, count, trip);
+		stats = world.get_path_cache_stats();
+		if (benchmarks.selected(name))
+		{
+			std::printf(
+			    "%-36s %8zu %12llu %14llu %14llu\n",
+			    "path cache hits, misses, unsnapped",
+			    count,
+			    static_cast<unsigned long long>(stats.hits),
+			    static_cast<unsigned long long>(stats.misses),
+			    static_cast<unsigned long long>(stats.unsnapped));
+			std::printf(
+			    "%-36s %8zu %12llu\n",
+			    "path cache too long",
+			    count,
+			    static_cast<unsigned long long>(stats.too_long));
+			std::printf(
+			    "%-36s %8zu %12s %14s %14.3f\n",
+			    "path cache longest detour",
+			    count,
+			    "",
+			    "",
+			    longest_detour);
+		}
+	}
+
+	//an edit has to drop the paths over the floor, not serve them again
+	Obstacle block;
+	block.position = segments[0].to;
+	block.size = {0.05, 0.05};
+	world.add_obstacle(1, block);
+	//rebuilt in the background as the simulation does, the queries wait
+	world.start_visibility_graph_rebuilds();
+	world.set_wait_for_fresh_graphs(true);
+	for (auto &segment : segments)
+	{
+		world.calculate_path(0, segment.from, 1, segment.to, result);
+		if (!walkable(0, segment.from, 1, segment.to, result))
+		{
+			std::printf("cached path is not walkable after an edit\n");
+			mismatches++;
+			break;
+		}
+	}
+	if (world.get_path_cache_stats().invalidations == stats.invalidations)
+	{
+		std::printf("path cache kept paths over an edited floor\n");
+		mismatches++;
+	}
+	world.set_wait_for_fresh_graphs(false);
+}
+
+void print_usage(const char *program)
+{
+	std::printf(
+	    "usage: %s [--max-obstacles N] [--max-graph-obstacles N] "
+	    "[--min-time SECONDS] [--filter TEXT]\n",
+	    program);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		auto has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--max-obstacles") && has_value)
+		{
+			options.max_obstacles = std::stoull(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "--max-graph-obstacles") && has_value)
+		{
+			options.max_graph_obstacles = std::stoull(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "--min-time") && has_value)
+		{
+			options.min_seconds = std::stod(argv[++i]);
+		}
+		else if (!std::strcmp(argv[i], "--filter") && has_value)
+		{
+			options.filter = argv[++i];
+		}
+		else
+		{
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::printf(
+	    "segment kernel: %s, simulation scalar: %s\n",
+	    SegmentKernel::implementation_name(),
+	    sizeof(sim_scalar) == sizeof(float) ? "float" : "double");
+	std::printf(
+	    "%-36s %8s %12s %14s %14s\n",
+	    "benchmark",
+	    "obstacles",
+	    "calls",
+	    "ns/call",
+	    "ns/obstacle");
+
+	Benchmarks benchmarks{options};
+	for (size_t count : {10, 100, 1000, 10000, 100000})
+	{
+		if (count > options.max_obstacles)
+		{
+			break;
+		}
+		auto floor = make_floor(count, count);
+		run_obstacle_benchmarks(benchmarks, floor);
+		run_floor_benchmarks(benchmarks, floor);
+		run_world_benchmarks(benchmarks, floor);
+	}
+	std::printf("checksum %zu\n", checksum);
+	return mismatches == 0 ? 0 : 1;
+}
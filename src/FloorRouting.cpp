@@ -0,0 +1,630 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <limits>
+
+#include "AStar.hpp"
+#include "Hash.hpp"
+
+//routes across floors: a small graph of the floor changer ends, with the
+//shortest distances between the ends on each floor as its edges, picks the
+//changers and only the legs between them are searched on the floors
+
+namespace
+{
+constexpr double unreachable = std::numeric_limits<double>::infinity();
+constexpr size_t none = std::numeric_limits<size_t>::max();
+
+double path_length(const std::vector<glm::dvec2> &path)
+{
+	double length = 0;
+	for (size_t i = 1; i < path.size(); i++)
+	{
+		length += glm::distance(path[i - 1], path[i]);
+	}
+	return length;
+}
+} // namespace
+
+PathSearchContext &World::search_context()
+{
+	thread_local PathSearchContext context;
+	return context;
+}
+
+bool World::cached_path(
+    int from_floor,
+    glm::dvec2 from,
+    int to_floor,
+    glm::dvec2 to,
+    PathResult &result) const
+{
+	result.waypoints.clear();
+	result.force_teleport = false;
+	//a straight line is as short as it gets, going by the vertecies would
+	//only make it longer
+	if (from_floor == to_floor && m_map.contains(from_floor)
+	    && test_line_of_sight(from_floor, from, to, true, false))
+	{
+		result.waypoints.emplace_back(from);
+		result.waypoints.emplace_back(to);
+		return true;
+	}
+	auto start = snap_to_vertex(from_floor, from);
+	auto target = snap_to_vertex(to_floor, to);
+	if (!start || !target)
+	{
+		m_path_cache.count_unsnapped();
+		return false;
+	}
+
+	PathCache::Key key{from_floor, *start, to_floor, *target};
+	auto changers = changers_hash();
+	auto path = m_path_cache.find(
+	    key,
+	    changers,
+	    [this](int floor) -> std::optional<uint64_t> {
+		    auto found = m_map.find(floor);
+		    if (found == m_map.end())
+		    {
+			    return std::nullopt;
+		    }
+		    return found->second.version();
+	    });
+	if (!path)
+	{
+		auto found = std::make_shared<PathResult>();
+		plan_path(from_floor, *start, to_floor, *target, *found);
+		if (found->force_teleport)
+		{
+			return false;
+		}
+		PathCache::Origin origin{{}, changers};
+		bool fresh = true;
+		auto add_floor = [&](int floor) {
+			for (auto &[seen, version] : origin.floor_versions)
+			{
+				if (seen == floor)
+				{
+					return;
+				}
+			}
+			auto &floor_ref = m_map.at(floor);
+			origin.floor_versions.emplace_back(floor, floor_ref.version());
+			fresh = fresh && !floor_ref.rebuilding_visibility_graph();
+		};
+		add_floor(from_floor);
+		for (auto &waypoint : found->waypoints)
+		{
+			if (waypoint.index() == 1)
+			{
+				add_floor(std::get<1>(waypoint).first);
+			}
+		}
+		//a path on a graph that is still catching up with an edit would
+		//outlive the edit, the version is the same
+		if (fresh)
+		{
+			m_path_cache.insert(key, found, std::move(origin));
+		}
+		path = std::move(found);
+	}
+
+	//the real start and target join the path at the waypoints they see
+	//that make it shortest, on its first and its last floor, the snapped
+	//vertecies are seen from them and are the fallback
+	auto &waypoints = path->waypoints;
+	auto &along = search_context().along;
+	along.assign(waypoints.size(), 0);
+	auto position = [&](size_t waypoint) {
+		auto &place = waypoints[waypoint];
+		return place.index() == 0 ? std::get<0>(place)
+		                          : std::get<1>(place).second;
+	};
+	for (size_t i = 1; i < waypoints.size(); i++)
+	{
+		along[i] = along[i - 1];
+		if (waypoints[i].index() == 0)
+		{
+			along[i] += glm::distance(position(i - 1), position(i));
+		}
+	}
+	size_t first_change = 0, last_change = waypoints.size();
+	while (first_change < waypoints.size()
+	       && waypoints[first_change].index() == 0)
+	{
+		first_change++;
+	}
+	while (last_change > 0 && waypoints[last_change - 1].index() == 0)
+	{
+		last_change--;
+	}
+	//every part of the path is a shortest one, so the shortest path from
+	//the start to the target can't be shorter than the path less the ways
+	//to and from it, going by the snapped vertecies, which both see
+	auto total = along.back();
+	auto shortest = total - glm::distance(from, position(0))
+	                - glm::distance(position(waypoints.size() - 1), to);
+	if (from_floor == to_floor)
+	{
+		shortest = std::max(shortest, glm::distance(from, to));
+	}
+	auto allowed = m_path_cache.max_detour() * shortest;
+	//joining the start at waypoint i and the target at waypoint j makes a
+	//path first_cost(i) + last_cost(j) long
+	auto first_cost = [&](size_t i) {
+		return glm::distance(from, position(i)) - along[i];
+	};
+	auto last_cost = [&](size_t i) {
+		return along[i] + glm::distance(position(i), to);
+	};
+	//no line of sight is tested for paths that can't get short enough
+	double lowest_first = first_cost(0), lowest_last = last_cost(last_change);
+	for (size_t i = 1; i < first_change; i++)
+	{
+		lowest_first = std::min(lowest_first, first_cost(i));
+	}
+	for (size_t i = last_change; i < waypoints.size(); i++)
+	{
+		lowest_last = std::min(lowest_last, last_cost(i));
+	}
+	if (!(lowest_first + lowest_last <= allowed))
+	{
+		m_path_cache.count_too_long();
+		return false;
+	}
+
+	size_t first = 0;
+	for (size_t i = 1; i < first_change; i++)
+	{
+		if (first_cost(i) < first_cost(first)
+		    && test_line_of_sight(from_floor, from, position(i), true, false))
+		{
+			first = i;
+		}
+	}
+	size_t last = waypoints.size() - 1;
+	for (size_t i = std::max(first, last_change); i < waypoints.size() - 1;
+	     i++)
+	{
+		if (last_cost(i) < last_cost(last)
+		    && test_line_of_sight(to_floor, to, position(i), true, false))
+		{
+			last = i;
+		}
+	}
+	if (!(first_cost(first) + last_cost(last) <= allowed))
+	{
+		m_path_cache.count_too_long();
+		return false;
+	}
+	result.waypoints.emplace_back(from);
+	result.waypoints.insert(
+	    result.waypoints.end(),
+	    waypoints.begin() + first,
+	    waypoints.begin() + last + 1);
+	result.waypoints.emplace_back(to);
+	return true;
+}
+
+std::optional<glm::dvec2>
+World::snap_to_vertex(int floor_index, glm::dvec2 point) const
+{
+	auto found = m_map.find(floor_index);
+	if (found == m_map.end()
+	    || found->second.pathing_backend != PathingBackend::visibility_graph)
+	{
+		return std::nullopt;
+	}
+	auto graph
+	    = found->second.visibility_graph_snapshot(m_wait_for_fresh_graphs);
+	//the nearest few, nearest first, the very nearest is often behind the
+	//obstacle it belongs to
+	std::array<uint32_t, 4> nearest;
+	auto count = graph->nearest(point, nearest);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto vertex = graph->position(nearest[i]);
+		if (test_line_of_sight(floor_index, point, vertex, true, false))
+		{
+			return vertex;
+		}
+	}
+	return std::nullopt;
+}
+
+uint64_t World::changers_hash() const
+{
+	uint64_t hash = floor_changers.size();
+	for (auto &changer : floor_changers)
+	{
+		for (auto &end : {changer.a, changer.b})
+		{
+			hash = mix64(hash ^ static_cast<uint32_t>(end.first));
+			hash = mix64(hash ^ std::bit_cast<uint64_t>(end.second.x));
+			hash = mix64(hash ^ std::bit_cast<uint64_t>(end.second.y));
+		}
+	}
+	return hash;
+}
+
+std::optional<size_t> World::floor_route(
+    int floor_index,
+    glm::dvec2 start,
+    std::span<const glm::dvec2> ends,
+    PathSearchContext &context) const
+{
+	auto &floor = m_map.at(floor_index);
+	if (floor.pathing_backend == PathingBackend::nav_mesh)
+	{
+		auto path = floor.get_nav_mesh().find_path(start, ends);
+		if (!path)
+		{
+			return std::nullopt;
+		}
+		context.leg = std::move(path->first);
+		return path->second;
+	}
+	auto graph = floor.visibility_graph_snapshot(m_wait_for_fresh_graphs);
+	auto visibility = [this, floor_index](
+	                      std::span<const LineSegment> segments,
+	                      std::span<bool> out) {
+		test_line_of_sight_batch(floor_index, segments, {.movement = true}, out);
+	};
+	if (auto field = floor.get_flow_fields().find(ends, graph, visibility))
+	{
+		auto sight
+		    = sight_from(floor_index, start, *graph, ends, context.search);
+		return field->find_path(
+		    start,
+		    sight.first(graph->size()),
+		    sight.subspan(graph->size()),
+		    context.leg);
+	}
+	if (auto table = floor.get_route_tables().find(graph))
+	{
+		return table->find_path(start, ends, visibility, context.leg);
+	}
+	auto landmarks = floor.get_landmarks().find(graph);
+	AStar pather{
+	    context.search,
+	    start,
+	    ends,
+	    visibility,
+	    *graph,
+	    landmarks.get()};
+	pather.run();
+	floor.get_landmarks().count_search(pather.expansions());
+	return pather.path_result(context.leg);
+}
+
+std::span<const bool> World::sight_from(
+    int floor_index,
+    glm::dvec2 point,
+    const VisibilityGraph &graph,
+    std::span<const glm::dvec2> ends,
+    AStar::Buffers &buffers) const
+{
+	auto &segments = buffers.segments;
+	segments.clear();
+	for (size_t i = 0; i < graph.size(); i++)
+	{
+		segments.push_back({point, graph.position(i)});
+	}
+	for (auto end : ends)
+	{
+		segments.push_back({end, point});
+	}
+	auto visible = buffers.visible(segments.size());
+	test_line_of_sight_batch(floor_index, segments, {.movement = true}, visible);
+	return visible;
+}
+
+bool World::changer_tables_current() const
+{
+	if (m_tabled_changers != floor_changers)
+	{
+		return false;
+	}
+	//a floor the changers lead to may have been added since
+	for (auto &changer : floor_changers)
+	{
+		if (changer.a.first == changer.b.first)
+		{
+			continue;
+		}
+		for (auto floor : {changer.a.first, changer.b.first})
+		{
+			if (m_map.contains(floor) != m_changer_tables.contains(floor))
+			{
+				return false;
+			}
+		}
+	}
+	for (auto &[index, table] : m_changer_tables)
+	{
+		auto found = m_map.find(index);
+		if (found == m_map.end())
+		{
+			return false;
+		}
+		auto &floor = found->second;
+		if (table.floor_version != floor.version()
+		    || table.backend != floor.pathing_backend
+		    || (table.backend == PathingBackend::visibility_graph
+		        && table.graph
+		               != floor.visibility_graph_snapshot(
+		                   m_wait_for_fresh_graphs)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void World::update_changer_tables() const
+{
+	if (changer_tables_current())
+	{
+		return;
+	}
+	m_tabled_changers = floor_changers;
+	struct Ends
+	{
+		std::vector<size_t> ends;
+		std::vector<glm::dvec2> positions;
+	};
+	std::unordered_map<int, Ends> ends_on;
+	for (size_t i = 0; i < floor_changers.size(); i++)
+	{
+		auto &changer = floor_changers[i];
+		//a changer within one floor leads nowhere new
+		if (changer.a.first == changer.b.first)
+		{
+			continue;
+		}
+		for (size_t side = 0; side < 2; side++)
+		{
+			auto &end = side ? changer.b : changer.a;
+			if (m_map.contains(end.first))
+			{
+				ends_on[end.first].ends.push_back(i * 2 + side);
+				ends_on[end.first].positions.push_back(end.second);
+			}
+		}
+	}
+	std::erase_if(m_changer_tables, [&](auto &table) {
+		return !ends_on.contains(table.first);
+	});
+
+	for (auto &[index, ends] : ends_on)
+	{
+		auto &floor = m_map.at(index);
+		auto &table = m_changer_tables[index];
+		std::shared_ptr<const VisibilityGraph> graph;
+		if (floor.pathing_backend == PathingBackend::visibility_graph)
+		{
+			graph = floor.visibility_graph_snapshot(m_wait_for_fresh_graphs);
+		}
+		if (table.ends == ends.ends && table.positions == ends.positions
+		    && table.floor_version == floor.version()
+		    && table.backend == floor.pathing_backend && table.graph == graph)
+		{
+			continue;
+		}
+
+		table.ends = std::move(ends.ends);
+		table.positions = std::move(ends.positions);
+		table.floor_version = floor.version();
+		table.backend = floor.pathing_backend;
+		table.graph = graph;
+		table.fields.clear();
+		auto count = table.ends.size();
+		table.distances.assign(count * count, unreachable);
+		for (size_t i = 0; i < count; i++)
+		{
+			table.distances[i * count + i] = 0;
+		}
+		//the ways between two ends are the same both ways, each is found
+		//once
+		auto set_distance = [&](size_t i, size_t j, auto &path) {
+			if (path)
+			{
+				table.distances[i * count + j] = path_length(path->first);
+				table.distances[j * count + i] = table.distances[i * count + j];
+			}
+		};
+		if (graph)
+		{
+			auto visibility = [this, index](
+			                      std::span<const LineSegment> segments,
+			                      std::span<bool> out) {
+				test_line_of_sight_batch(index, segments, {.movement = true}, out);
+			};
+			for (auto position : table.positions)
+			{
+				table.fields.emplace_back(
+				    graph,
+				    std::vector<glm::dvec2>{position},
+				    visibility);
+			}
+			for (size_t j = 0; j < count; j++)
+			{
+				for (size_t i = 0; i < j; i++)
+				{
+					auto path = table.fields[j].find_path(
+					    table.positions[i],
+					    visibility);
+					set_distance(i, j, path);
+				}
+			}
+		}
+		else
+		{
+			auto &mesh = floor.get_nav_mesh();
+			for (size_t j = 0; j < count; j++)
+			{
+				for (size_t i = 0; i < j; i++)
+				{
+					auto path = mesh.find_path(
+					    table.positions[i],
+					    {&table.positions[j], 1});
+					set_distance(i, j, path);
+				}
+			}
+		}
+	}
+}
+
+void World::distances_to_changers(
+    int floor_index,
+    glm::dvec2 point,
+    std::vector<double> &distances,
+    PathSearchContext &context) const
+{
+	auto &table = m_changer_tables.at(floor_index);
+	distances.assign(table.ends.size(), unreachable);
+	if (table.fields.empty())
+	{
+		auto &mesh = m_map.at(floor_index).get_nav_mesh();
+		for (size_t i = 0; i < table.ends.size(); i++)
+		{
+			if (auto path = mesh.find_path(point, {&table.positions[i], 1}))
+			{
+				distances[i] = path_length(path->first);
+			}
+		}
+		return;
+	}
+
+	//every field is on the same graph, so one batch tells what point sees
+	//for all of them
+	auto &graph = *table.graph;
+	auto sight = sight_from(
+	    floor_index,
+	    point,
+	    graph,
+	    table.positions,
+	    context.search);
+	for (size_t i = 0; i < table.ends.size(); i++)
+	{
+		if (table.fields[i].find_path(
+		        point,
+		        sight.first(graph.size()),
+		        sight.subspan(graph.size() + i, 1),
+		        context.leg))
+		{
+			distances[i] = path_length(context.leg);
+		}
+	}
+}
+
+bool World::changer_route(
+    int from_floor,
+    glm::dvec2 from,
+    int to_floor,
+    glm::dvec2 to,
+    PathSearchContext &context) const
+{
+	//a query in a batch must not write to the tables the others read
+	if (!m_in_path_batch)
+	{
+		update_changer_tables();
+	}
+	if (!m_changer_tables.contains(from_floor)
+	    || !m_changer_tables.contains(to_floor))
+	{
+		return false;
+	}
+	auto &from_table = m_changer_tables.at(from_floor);
+	auto &to_table = m_changer_tables.at(to_floor);
+	auto &from_distances = context.from_distances;
+	auto &to_distances = context.to_distances;
+	distances_to_changers(from_floor, from, from_distances, context);
+	distances_to_changers(to_floor, to, to_distances, context);
+
+	//the table and the index in it of every changer end
+	auto end_count = floor_changers.size() * 2;
+	auto &slots = context.slots;
+	slots.assign(end_count, {nullptr, 0});
+	for (auto &[index, table] : m_changer_tables)
+	{
+		for (size_t i = 0; i < table.ends.size(); i++)
+		{
+			slots[table.ends[i]] = {&table, i};
+		}
+	}
+
+	//Dijkstra over the changer ends, from and to are numbered after them
+	auto start = end_count, goal = end_count + 1;
+	auto &distance = context.distance;
+	auto &previous = context.previous;
+	distance.assign(end_count + 2, unreachable);
+	previous.assign(end_count + 2, none);
+	//a binary heap with the nearest on top
+	auto &open = context.open;
+	open.clear();
+	auto relax = [&](size_t from_node, size_t node, double length) {
+		auto through = distance[from_node] + length;
+		if (through < distance[node])
+		{
+			distance[node] = through;
+			previous[node] = from_node;
+			open.emplace_back(through, node);
+			std::push_heap(open.begin(), open.end(), std::greater<>{});
+		}
+	};
+	distance[start] = 0;
+	for (size_t i = 0; i < from_table.ends.size(); i++)
+	{
+		relax(start, from_table.ends[i], from_distances[i]);
+	}
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), std::greater<>{});
+		auto [length, node] = open.back();
+		open.pop_back();
+		if (node == goal)
+		{
+			break;
+		}
+		if (length > distance[node])
+		{
+			continue;
+		}
+		auto [table, index] = slots[node];
+		//taking the changer to its other end, which is on another floor
+		if (slots[node ^ 1].first)
+		{
+			relax(node, node ^ 1, 0);
+		}
+		auto count = table->ends.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			relax(node, table->ends[i], table->distances[index * count + i]);
+		}
+		if (table == &to_table)
+		{
+			relax(node, goal, to_distances[index]);
+		}
+	}
+	if (previous[goal] == none)
+	{
+		return false;
+	}
+
+	//the ends a changer is taken from
+	auto &route = context.route;
+	route.clear();
+	for (auto node = previous[goal]; node != start; node = previous[node])
+	{
+		if (previous[node] == (node ^ 1))
+		{
+			route.push_back(previous[node]);
+		}
+	}
+	std::reverse(route.begin(), route.end());
+	return true;
+}
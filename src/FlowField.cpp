@@ -0,0 +1,376 @@
+#include "FlowField.hpp"
+
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <queue>
+
+FlowField::FlowField(
+    std::shared_ptr<const VisibilityGraph> graph,
+    std::vector<glm::dvec2> ends,
+    const Visibility &visibility)
+    : m_graph(std::move(graph)), m_ends(std::move(ends))
+{
+	auto vertex_count = m_graph->size();
+	m_distance.assign(vertex_count, std::numeric_limits<double>::infinity());
+	m_next.assign(vertex_count, none);
+
+	//the vertecies that see an end are the roots, segment
+	//i * ends + end is ends[end] -> i, the way AStar tests them
+	std::vector<LineSegment> segments;
+	segments.reserve(vertex_count * m_ends.size());
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		for (auto end : m_ends)
+		{
+			segments.push_back({end, m_graph->position(i)});
+		}
+	}
+	auto visible = std::make_unique<bool[]>(segments.size());
+	visibility(segments, {visible.get(), segments.size()});
+
+	using Candidate = std::pair<double, uint32_t>;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> open;
+	for (uint32_t i = 0; i < vertex_count; i++)
+	{
+		for (size_t end = 0; end < m_ends.size(); end++)
+		{
+			if (!visible[i * m_ends.size() + end])
+			{
+				continue;
+			}
+			auto distance = glm::distance(m_ends[end], m_graph->position(i));
+			if (distance < m_distance[i])
+			{
+				m_distance[i] = distance;
+				m_next[i] = static_cast<uint32_t>(vertex_count + end);
+			}
+		}
+		if (m_next[i] != none)
+		{
+			open.emplace(m_distance[i], i);
+		}
+	}
+
+	//Dijkstra outwards from the ends, the graph's edges go both ways
+	while (!open.empty())
+	{
+		auto [distance, i] = open.top();
+		open.pop();
+		if (distance > m_distance[i])
+		{
+			continue;
+		}
+		auto neighbours = m_graph->neighbours(i);
+		auto lengths = m_graph->lengths(i);
+		for (size_t k = 0; k < neighbours.size(); k++)
+		{
+			auto through = distance + lengths[k];
+			if (through < m_distance[neighbours[k]])
+			{
+				m_distance[neighbours[k]] = through;
+				m_next[neighbours[k]] = i;
+				open.emplace(through, neighbours[k]);
+			}
+		}
+	}
+}
+
+std::optional<std::pair<std::vector<glm::dvec2>, size_t>>
+FlowField::find_path(glm::dvec2 start, const Visibility &visibility) const
+{
+	auto vertex_count = m_graph->size();
+	//start -> i for every vertex, then ends[end] -> start
+	std::vector<LineSegment> segments;
+	segments.reserve(vertex_count + m_ends.size());
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		segments.push_back({start, m_graph->position(i)});
+	}
+	for (auto end : m_ends)
+	{
+		segments.push_back({end, start});
+	}
+	auto visible = std::make_unique<bool[]>(segments.size());
+	visibility(segments, {visible.get(), segments.size()});
+	return find_path(
+	    start,
+	    {visible.get(), vertex_count},
+	    {visible.get() + vertex_count, m_ends.size()});
+}
+
+std::optional<std::pair<std::vector<glm::dvec2>, size_t>> FlowField::find_path(
+    glm::dvec2 start,
+    std::span<const bool> sees_vertex,
+    std::span<const bool> sees_end) const
+{
+	std::vector<glm::dvec2> path;
+	auto end = find_path(start, sees_vertex, sees_end, path);
+	if (!end)
+	{
+		return std::nullopt;
+	}
+	return std::pair{std::move(path), *end};
+}
+
+std::optional<size_t> FlowField::find_path(
+    glm::dvec2 start,
+    std::span<const bool> sees_vertex,
+    std::span<const bool> sees_end,
+    std::vector<glm::dvec2> &path) const
+{
+	path.clear();
+	auto vertex_count = m_graph->size();
+	//the first step is to a vertex in sight or straight to an end
+	auto best = std::numeric_limits<double>::infinity();
+	auto first = none;
+	for (size_t end = 0; end < m_ends.size(); end++)
+	{
+		auto distance = glm::distance(start, m_ends[end]);
+		if (sees_end[end] && distance < best)
+		{
+			best = distance;
+			first = static_cast<uint32_t>(vertex_count + end);
+		}
+	}
+	for (uint32_t i = 0; i < vertex_count; i++)
+	{
+		if (!sees_vertex[i] || m_next[i] == none)
+		{
+			continue;
+		}
+		auto distance
+		    = glm::distance(start, m_graph->position(i)) + m_distance[i];
+		if (distance < best)
+		{
+			best = distance;
+			first = i;
+		}
+	}
+	if (first == none)
+	{
+		return std::nullopt;
+	}
+
+	path.push_back(start);
+	auto at = first;
+	for (; at < vertex_count; at = m_next[at])
+	{
+		path.push_back(m_graph->position(at));
+	}
+	path.push_back(m_ends[at - vertex_count]);
+	return at - vertex_count;
+}
+
+size_t FlowField::memory_bytes() const
+{
+	return m_ends.capacity() * sizeof(glm::dvec2)
+	       + m_distance.capacity() * sizeof(double)
+	       + m_next.capacity() * sizeof(uint32_t);
+}
+
+FlowFieldCache::FlowFieldCache(const FlowFieldCache &other) { *this = other; }
+
+FlowFieldCache &FlowFieldCache::operator=(const FlowFieldCache &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	Settings settings;
+	Stats stats;
+	{
+		std::lock_guard lock{other.m_mutex};
+		settings = other.m_settings;
+		stats = other.m_stats;
+	}
+	stats.fields = 0;
+	stats.bytes = 0;
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_settings = settings;
+	m_stats = stats;
+	return *this;
+}
+
+void FlowFieldCache::configure(Settings settings)
+{
+	std::lock_guard lock{m_mutex};
+	if (!settings.enabled)
+	{
+		m_entries.clear();
+	}
+	m_settings = settings;
+	evict();
+}
+
+FlowFieldCache::Settings FlowFieldCache::settings() const
+{
+	std::lock_guard lock{m_mutex};
+	return m_settings;
+}
+
+std::shared_ptr<const FlowField> FlowFieldCache::find(
+    std::span<const glm::dvec2> ends,
+    const std::shared_ptr<const VisibilityGraph> &graph,
+    const FlowField::Visibility &visibility)
+{
+	std::lock_guard lock{m_mutex};
+	if (!m_settings.enabled)
+	{
+		return nullptr;
+	}
+	m_clock++;
+	//a sweep every quarter of the idle time keeps the cold ends from
+	//piling up
+	if (!m_held && m_clock - m_last_eviction > m_settings.idle_queries / 4)
+	{
+		evict();
+	}
+	auto found = m_entries.find(ends);
+	if (found == m_entries.end())
+	{
+		found = m_entries.emplace(Key{ends.begin(), ends.end()}, Entry{}).first;
+	}
+	auto &entry = found->second;
+	entry.queries++;
+	entry.last_used = m_held ? held_use : m_clock;
+	if (entry.queries < m_settings.hot_after)
+	{
+		return nullptr;
+	}
+	if (entry.field && entry.field->graph() == graph)
+	{
+		m_stats.hits++;
+		return entry.field;
+	}
+	if (m_held)
+	{
+		if (std::ranges::none_of(m_held_builds, [&](const HeldBuild &build) {
+			    return KeyEqual{}(build.ends, ends);
+		    }))
+		{
+			m_held_builds.push_back({found->first, graph, visibility});
+		}
+		return nullptr;
+	}
+	//a field on an older graph is replaced as well
+	entry.field = std::make_shared<FlowField>(
+	    graph,
+	    std::vector<glm::dvec2>{ends.begin(), ends.end()},
+	    visibility);
+	m_stats.builds++;
+	auto field = entry.field;
+	evict();
+	return field;
+}
+
+void FlowFieldCache::clear()
+{
+	std::lock_guard lock{m_mutex};
+	for (auto &[key, entry] : m_entries)
+	{
+		entry.field.reset();
+	}
+}
+
+void FlowFieldCache::hold(bool held)
+{
+	std::lock_guard lock{m_mutex};
+	if (m_held && !held)
+	{
+		for (auto &[key, entry] : m_entries)
+		{
+			if (entry.last_used == held_use)
+			{
+				entry.last_used = m_clock;
+			}
+		}
+		for (auto &build : m_held_builds)
+		{
+			auto found = m_entries.find(build.ends);
+			if (found == m_entries.end())
+			{
+				continue;
+			}
+			auto &entry = found->second;
+			if (!entry.field || entry.field->graph() != build.graph)
+			{
+				entry.field = std::make_shared<FlowField>(
+				    build.graph,
+				    std::move(build.ends),
+				    build.visibility);
+				m_stats.builds++;
+			}
+		}
+		m_held_builds.clear();
+		evict();
+	}
+	m_held = held;
+}
+
+FlowFieldCache::Stats FlowFieldCache::stats() const
+{
+	std::lock_guard lock{m_mutex};
+	auto stats = m_stats;
+	for (auto &[key, entry] : m_entries)
+	{
+		if (entry.field)
+		{
+			stats.fields++;
+			stats.bytes += entry.field->memory_bytes();
+		}
+	}
+	return stats;
+}
+
+void FlowFieldCache::reset_stats()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats = {};
+}
+
+size_t
+FlowFieldCache::KeyHash::operator()(std::span<const glm::dvec2> ends) const
+{
+	uint64_t hash = ends.size();
+	for (auto end : ends)
+	{
+		hash = mix64(hash ^ std::bit_cast<uint64_t>(end.x));
+		hash = mix64(hash ^ std::bit_cast<uint64_t>(end.y));
+	}
+	return hash;
+}
+
+void FlowFieldCache::evict()
+{
+	m_last_eviction = m_clock;
+	size_t fields = 0;
+	for (auto entry = m_entries.begin(); entry != m_entries.end();)
+	{
+		if (m_clock - entry->second.last_used > m_settings.idle_queries)
+		{
+			m_stats.evictions += entry->second.field != nullptr;
+			entry = m_entries.erase(entry);
+			continue;
+		}
+		fields += entry->second.field != nullptr;
+		++entry;
+	}
+	for (; fields > m_settings.capacity; fields--)
+	{
+		Entry *oldest = nullptr;
+		for (auto &[key, entry] : m_entries)
+		{
+			if (entry.field
+			    && (!oldest || entry.last_used < oldest->last_used))
+			{
+				oldest = &entry;
+			}
+		}
+		oldest->field.reset();
+		m_stats.evictions++;
+	}
+}
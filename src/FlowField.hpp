@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "LineOfSight.hpp"
+#include "VisibilityGraph.hpp"
+
+//the shortest way from every vertex of a visibility graph to the nearest of
+//a fixed set of ends, a tree rooted at the ends
+//a path query only has to find the vertecies the start can see, so the
+//people heading to the same place share a single search
+class FlowField
+{
+	public:
+	//fills out[i] with whether segments[i] is unobstructed, like AStar's
+	using Visibility
+	    = std::function<void(std::span<const LineSegment>, std::span<bool>)>;
+
+	FlowField(
+	    std::shared_ptr<const VisibilityGraph> graph,
+	    std::vector<glm::dvec2> ends,
+	    const Visibility &visibility);
+
+	//start first and the end reached last, along with its index in ends,
+	//like AStar::path_result, a path as short as the one AStar finds
+	std::optional<std::pair<std::vector<glm::dvec2>, size_t>>
+	find_path(glm::dvec2 start, const Visibility &visibility) const;
+	//the same with the line of sight already known, sees_vertex[i] for
+	//start -> vertex i and sees_end[end] for ends[end] -> start
+	std::optional<std::pair<std::vector<glm::dvec2>, size_t>> find_path(
+	    glm::dvec2 start,
+	    std::span<const bool> sees_vertex,
+	    std::span<const bool> sees_end) const;
+	//the same into path, which keeps its capacity, and the index of the end
+	std::optional<size_t> find_path(
+	    glm::dvec2 start,
+	    std::span<const bool> sees_vertex,
+	    std::span<const bool> sees_end,
+	    std::vector<glm::dvec2> &path) const;
+
+	//the graph it was built on
+	const std::shared_ptr<const VisibilityGraph> &graph() const
+	{
+		return m_graph;
+	}
+	//bytes allocated for the arrays
+	size_t memory_bytes() const;
+
+	private:
+	static constexpr uint32_t none = UINT32_MAX;
+
+	std::shared_ptr<const VisibilityGraph> m_graph;
+	std::vector<glm::dvec2> m_ends;
+	//per vertex the length of the way to the nearest end, infinite if
+	//there is none
+	std::vector<double> m_distance;
+	//per vertex the next vertex on the way, or the graph's size plus the
+	//index of the end if that is in sight
+	std::vector<uint32_t> m_next;
+};
+
+//the flow fields of one floor, for the sets of ends that are asked for
+//often
+//a set of ends is hot once it was asked for hot_after times without a break
+//of idle_queries queries of the floor, such a break also drops its field
+class FlowFieldCache
+{
+	public:
+	struct Settings
+	{
+		bool enabled = false;
+		size_t hot_after = 8;
+		//fields kept at most, the least recently used one goes first
+		size_t capacity = 16;
+		uint64_t idle_queries = 4096;
+	};
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t builds = 0;
+		uint64_t evictions = 0;
+		size_t fields = 0;
+		size_t bytes = 0;
+
+		Stats &operator+=(const Stats &other)
+		{
+			hits += other.hits;
+			builds += other.builds;
+			evictions += other.evictions;
+			fields += other.fields;
+			bytes += other.bytes;
+			return *this;
+		}
+	};
+
+	FlowFieldCache() = default;
+	//copies only the settings and counters, never the fields
+	FlowFieldCache(const FlowFieldCache &other);
+	FlowFieldCache &operator=(const FlowFieldCache &other);
+
+	void configure(Settings settings);
+	Settings settings() const;
+
+	//counts a query for ends, the field for them once they are hot, built
+	//on graph first if there is none for it yet
+	std::shared_ptr<const FlowField> find(
+	    std::span<const glm::dvec2> ends,
+	    const std::shared_ptr<const VisibilityGraph> &graph,
+	    const FlowField::Visibility &visibility);
+	//drops every field but remembers which ends are hot, has to be called
+	//whenever an obstacle changes
+	void clear();
+	//while held queries are counted but only the fields there already are
+	//handed out, none are built or dropped, so queries running side by side
+	//in any order get the same answers, see World::calculate_paths
+	//the ends asked for meanwhile count as used and the ones that got hot
+	//have their fields built when the hold ends
+	void hold(bool held);
+
+	Stats stats() const;
+	void reset_stats();
+
+	private:
+	//the ends, looked up by span so that a query for known ends allocates
+	//nothing
+	using Key = std::vector<glm::dvec2>;
+	struct KeyHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::span<const glm::dvec2> ends) const;
+	};
+	struct KeyEqual
+	{
+		using is_transparent = void;
+		bool operator()(
+		    std::span<const glm::dvec2> a,
+		    std::span<const glm::dvec2> b) const
+		{
+			return std::ranges::equal(a, b);
+		}
+	};
+	//the last_used of the ends asked for while held
+	static constexpr uint64_t held_use = UINT64_MAX;
+	struct Entry
+	{
+		size_t queries = 0;
+		uint64_t last_used = 0;
+		std::shared_ptr<const FlowField> field;
+	};
+
+	//drops the entries not asked for in idle_queries and the least
+	//recently used fields past capacity
+	void evict();
+
+	mutable std::mutex m_mutex;
+	Settings m_settings;
+	std::unordered_map<Key, Entry, KeyHash, KeyEqual> m_entries;
+	//counts the queries
+	uint64_t m_clock = 0;
+	uint64_t m_last_eviction = 0;
+	Stats m_stats;
+	bool m_held = false;
+	//the hot ends without a field asked for while held
+	struct HeldBuild
+	{
+		Key ends;
+		std::shared_ptr<const VisibilityGraph> graph;
+		FlowField::Visibility visibility;
+	};
+	std::vector<HeldBuild> m_held_builds;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+//the 64 bit finalizer of splitmix64, it spreads nearby values over every
+//bit, the key hashes of the caches fold their fields in one at a time
+inline uint64_t mix64(uint64_t value)
+{
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ull;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebull;
+	value ^= value >> 31;
+	return value;
+}
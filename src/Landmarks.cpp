@@ -0,0 +1,188 @@
+#include "Landmarks.hpp"
+
+#include <limits>
+#include <queue>
+
+namespace
+{
+//the length of the shortest way from source to every vertex, the graph's
+//edges go both ways
+void shortest_distances(
+    const VisibilityGraph &graph,
+    uint32_t source,
+    std::vector<double> &distance)
+{
+	distance.assign(graph.size(), std::numeric_limits<double>::infinity());
+	using Candidate = std::pair<double, uint32_t>;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> open;
+	distance[source] = 0;
+	open.emplace(0, source);
+	while (!open.empty())
+	{
+		auto [length, i] = open.top();
+		open.pop();
+		if (length > distance[i])
+		{
+			continue;
+		}
+		auto neighbours = graph.neighbours(i);
+		auto lengths = graph.lengths(i);
+		for (size_t k = 0; k < neighbours.size(); k++)
+		{
+			auto through = length + lengths[k];
+			if (through < distance[neighbours[k]])
+			{
+				distance[neighbours[k]] = through;
+				open.emplace(through, neighbours[k]);
+			}
+		}
+	}
+}
+} // namespace
+
+Landmarks::Landmarks(
+    std::shared_ptr<const VisibilityGraph> graph,
+    size_t count)
+    : m_graph(std::move(graph))
+{
+	auto vertex_count = m_graph->size();
+	//vertecies without edges are only ever reached from a start or an end,
+	//a landmark there bounds nothing
+	uint32_t seed = 0;
+	while (seed < vertex_count && m_graph->neighbours(seed).empty())
+	{
+		seed++;
+	}
+	if (seed == vertex_count)
+	{
+		return;
+	}
+
+	//how far every vertex is from the nearest landmark so far, infinite for
+	//the ones no landmark reaches, which then go first
+	std::vector<double> nearest;
+	shortest_distances(*m_graph, seed, nearest);
+	std::vector<std::vector<double>> tables;
+	while (tables.size() < count)
+	{
+		uint32_t furthest = 0;
+		double furthest_distance = -1;
+		for (uint32_t i = 0; i < vertex_count; i++)
+		{
+			if (!m_graph->neighbours(i).empty()
+			    && nearest[i] > furthest_distance)
+			{
+				furthest = i;
+				furthest_distance = nearest[i];
+			}
+		}
+		//every vertex with edges is a landmark already
+		if (furthest_distance <= 0)
+		{
+			break;
+		}
+		m_landmarks.push_back(furthest);
+		shortest_distances(*m_graph, furthest, tables.emplace_back());
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			nearest[i] = std::min(nearest[i], tables.back()[i]);
+		}
+	}
+
+	m_distances.resize(vertex_count * m_landmarks.size());
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		for (size_t landmark = 0; landmark < m_landmarks.size(); landmark++)
+		{
+			m_distances[i * m_landmarks.size() + landmark]
+			    = tables[landmark][i];
+		}
+	}
+}
+
+size_t Landmarks::memory_bytes() const
+{
+	return m_landmarks.capacity() * sizeof(uint32_t)
+	       + m_distances.capacity() * sizeof(double);
+}
+
+LandmarkCache::LandmarkCache(const LandmarkCache &other) { *this = other; }
+
+LandmarkCache &LandmarkCache::operator=(const LandmarkCache &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	Settings settings;
+	Stats stats;
+	{
+		std::lock_guard lock{other.m_mutex};
+		settings = other.m_settings;
+		stats = other.m_stats;
+	}
+	std::lock_guard lock{m_mutex};
+	m_landmarks = nullptr;
+	m_settings = settings;
+	m_stats = stats;
+	return *this;
+}
+
+void LandmarkCache::configure(Settings settings)
+{
+	std::lock_guard lock{m_mutex};
+	if (settings.count != m_settings.count)
+	{
+		m_landmarks = nullptr;
+	}
+	m_settings = settings;
+}
+
+LandmarkCache::Settings LandmarkCache::settings() const
+{
+	std::lock_guard lock{m_mutex};
+	return m_settings;
+}
+
+std::shared_ptr<const Landmarks>
+LandmarkCache::find(const std::shared_ptr<const VisibilityGraph> &graph)
+{
+	std::lock_guard lock{m_mutex};
+	if (m_settings.count == 0)
+	{
+		return nullptr;
+	}
+	if (!m_landmarks || m_landmarks->graph() != graph)
+	{
+		//built under the lock, a search waiting for it would otherwise
+		//build the same landmarks again
+		m_landmarks = std::make_shared<Landmarks>(graph, m_settings.count);
+		m_stats.builds++;
+	}
+	return m_landmarks;
+}
+
+void LandmarkCache::count_search(size_t expansions)
+{
+	std::lock_guard lock{m_mutex};
+	m_stats.searches++;
+	m_stats.expansions += expansions;
+}
+
+LandmarkCache::Stats LandmarkCache::stats() const
+{
+	std::lock_guard lock{m_mutex};
+	auto stats = m_stats;
+	if (m_landmarks)
+	{
+		stats.landmarks = m_landmarks->count();
+		stats.bytes = m_landmarks->memory_bytes();
+	}
+	return stats;
+}
+
+void LandmarkCache::reset_stats()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats = {};
+}
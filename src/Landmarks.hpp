@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "VisibilityGraph.hpp"
+
+//ALT preprocessing of a visibility graph, the length of the shortest way
+//from a few landmark vertecies to every vertex
+//by the triangle inequality a vertex is at least |d(L, v) - d(L, end)| away
+//from an end, which AStar uses next to the straight line distance, see
+//AStar::landmark_bound
+//the landmarks are picked farthest first, each the vertex furthest along
+//the graph from the ones before, so they end up on the rim of the floor
+class Landmarks
+{
+	public:
+	Landmarks(std::shared_ptr<const VisibilityGraph> graph, size_t count);
+
+	const std::shared_ptr<const VisibilityGraph> &graph() const
+	{
+		return m_graph;
+	}
+	size_t count() const { return m_landmarks.size(); }
+	std::span<const uint32_t> vertecies() const { return m_landmarks; }
+	//the distance from every landmark to vertex, infinite for the ones it
+	//can't be reached from
+	std::span<const double> distances(size_t vertex) const
+	{
+		return {m_distances.data() + vertex * count(), count()};
+	}
+
+	//bytes allocated for the tables
+	size_t memory_bytes() const;
+
+	private:
+	std::shared_ptr<const VisibilityGraph> m_graph;
+	std::vector<uint32_t> m_landmarks;
+	//landmark distances of vertex i at [i * count(), (i + 1) * count())
+	std::vector<double> m_distances;
+};
+
+//the landmarks of one floor, for its latest visibility graph, and counters
+//of the A* searches made on it
+class LandmarkCache
+{
+	public:
+	struct Settings
+	{
+		//0 turns landmarks off, which is the default, testing which
+		//vertecies the start and the ends see takes most of a search, so
+		//the nodes the bound saves hardly show in its time
+		size_t count = 0;
+	};
+	struct Stats
+	{
+		uint64_t builds = 0;
+		size_t landmarks = 0;
+		size_t bytes = 0;
+		//counted whether landmarks are on or not, to compare
+		uint64_t searches = 0;
+		uint64_t expansions = 0;
+
+		Stats &operator+=(const Stats &other)
+		{
+			builds += other.builds;
+			landmarks += other.landmarks;
+			bytes += other.bytes;
+			searches += other.searches;
+			expansions += other.expansions;
+			return *this;
+		}
+	};
+
+	LandmarkCache() = default;
+	//copies only the settings and counters, never the landmarks
+	LandmarkCache(const LandmarkCache &other);
+	LandmarkCache &operator=(const LandmarkCache &other);
+
+	void configure(Settings settings);
+	Settings settings() const;
+
+	//the landmarks for graph, built first if they are for another one,
+	//nullptr while they are off
+	std::shared_ptr<const Landmarks>
+	find(const std::shared_ptr<const VisibilityGraph> &graph);
+	//counts an A* search that closed expansions nodes
+	void count_search(size_t expansions);
+
+	Stats stats() const;
+	void reset_stats();
+
+	private:
+	mutable std::mutex m_mutex;
+	Settings m_settings;
+	std::shared_ptr<const Landmarks> m_landmarks;
+	Stats m_stats;
+};
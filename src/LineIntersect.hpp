@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+
+//how far past the ends of both segments LineLineIntersect still accepts a hit
+constexpr double intersect_epsilon = 0.00001;
+//well above intersect_epsilon, a segment staying further than this from an
+//obstacle's outline or bounding box can't be hit by the exact test, every
+//shortcut that skips LineLineIntersect grows its bounds by it
+constexpr double intersect_margin = 1e-4;
+
+template <typename T>
+inline bool is_within(T val, T a, T b)
+{
+	if (a > b)
+	{
+		std::swap(a, b);
+	}
+	return a - val <= T(intersect_epsilon) && b - val >= -T(intersect_epsilon);
+}
+
+template <typename T>
+inline T Det(T a, T b, T c, T d)
+{
+	return a * d - b * c;
+}
+
+template <typename T>
+bool LineLineIntersect(
+    T x1,
+    T y1, //Line 1 start
+    T x2,
+    T y2, //Line 1 end
+    T x3,
+    T y3, //Line 2 start
+    T x4,
+    T y4, //Line 2 end
+    T &ixOut,
+    T &iyOut) //Output
+{
+	//http://mathworld.wolfram.com/Line-LineIntersection.html
+
+	T detL1 = Det(x1, y1, x2, y2);
+	T detL2 = Det(x3, y3, x4, y4);
+	T x1mx2 = x1 - x2;
+	T x3mx4 = x3 - x4;
+	T y1my2 = y1 - y2;
+	T y3my4 = y3 - y4;
+
+	T xnom = Det(detL1, x1mx2, detL2, x3mx4);
+	T ynom = Det(detL1, y1my2, detL2, y3my4);
+	T denom = Det(x1mx2, y1my2, x3mx4, y3my4);
+	if (denom == T(0)) //Lines don't seem to cross
+	{
+		ixOut = NAN;
+		iyOut = NAN;
+		return false;
+	}
+
+	ixOut = xnom / denom;
+	iyOut = ynom / denom;
+	if (!std::isfinite(ixOut)
+	    || !std::isfinite(iyOut)) //Probably a numerical issue
+		return false;
+
+	if (is_within(ixOut, x1, x2) && is_within(ixOut, x3, x4)
+	    && is_within(iyOut, y1, y2) && is_within(iyOut, y3, y4))
+	{
+		return true; //All OK
+	}
+
+	return false;
+}
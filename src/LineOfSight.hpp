@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glm/ext.hpp>
+
+#include "Precision.hpp"
+
+template <typename T>
+struct BasicLineSegment
+{
+	vec2_of<T> from;
+	vec2_of<T> to;
+};
+using LineSegment = BasicLineSegment<double>;
+using SimLineSegment = BasicLineSegment<sim_scalar>;
+
+//which obstacles count for a line of sight test, see Floor::test_line_of_sight
+struct LineOfSightFlags
+{
+	bool movement = false;
+	bool infection = false;
+	double expand = 0;
+};
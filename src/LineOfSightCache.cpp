@@ -0,0 +1,177 @@
+#include "LineOfSightCache.hpp"
+
+#include "Hash.hpp"
+
+#include <bit>
+#include <cmath>
+
+LineOfSightCache::LineOfSightCache(const LineOfSightCache &other)
+{
+	*this = other;
+}
+
+LineOfSightCache &LineOfSightCache::operator=(const LineOfSightCache &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	Settings settings;
+	Stats stats;
+	{
+		std::lock_guard lock{other.m_mutex};
+		settings = other.m_settings;
+		stats = other.m_stats;
+	}
+	stats.entries = 0;
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_index.clear();
+	m_settings = settings;
+	m_stats = stats;
+	m_enabled = settings.enabled;
+	return *this;
+}
+
+void LineOfSightCache::configure(Settings settings)
+{
+	std::lock_guard lock{m_mutex};
+	if (settings.quantum != m_settings.quantum || !settings.enabled)
+	{
+		m_entries.clear();
+		m_index.clear();
+	}
+	m_settings = settings;
+	evict_to(settings.capacity);
+	m_enabled = settings.enabled && settings.capacity > 0;
+}
+
+LineOfSightCache::Settings LineOfSightCache::settings() const
+{
+	std::lock_guard lock{m_mutex};
+	return m_settings;
+}
+
+std::optional<bool> LineOfSightCache::find(const Query &query)
+{
+	if (!enabled())
+	{
+		return std::nullopt;
+	}
+	std::lock_guard lock{m_mutex};
+	auto key = make_key(query);
+	if (!key)
+	{
+		return std::nullopt;
+	}
+	auto found = m_index.find(*key);
+	if (found == m_index.end())
+	{
+		m_stats.misses++;
+		return std::nullopt;
+	}
+	m_stats.hits++;
+	if (!m_held)
+	{
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+	}
+	return found->second->second;
+}
+
+void LineOfSightCache::insert(const Query &query, bool visible)
+{
+	if (!enabled())
+	{
+		return;
+	}
+	std::lock_guard lock{m_mutex};
+	auto key = make_key(query);
+	if (!key || m_settings.capacity == 0 || m_held)
+	{
+		return;
+	}
+	if (auto found = m_index.find(*key); found != m_index.end())
+	{
+		found->second->second = visible;
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+		return;
+	}
+	evict_to(m_settings.capacity - 1);
+	m_entries.emplace_front(*key, visible);
+	m_index.emplace(*key, m_entries.begin());
+}
+
+void LineOfSightCache::clear()
+{
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_index.clear();
+}
+
+void LineOfSightCache::hold(bool held)
+{
+	std::lock_guard lock{m_mutex};
+	m_held = held;
+}
+
+LineOfSightCache::Stats LineOfSightCache::stats() const
+{
+	std::lock_guard lock{m_mutex};
+	auto stats = m_stats;
+	stats.entries = m_entries.size();
+	return stats;
+}
+
+void LineOfSightCache::reset_stats()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats = {};
+}
+
+size_t LineOfSightCache::KeyHash::operator()(const Key &key) const
+{
+	uint64_t hash = key.flags;
+	for (auto value : {key.from_x, key.from_y, key.to_x, key.to_y})
+	{
+		hash = mix64(hash ^ static_cast<uint64_t>(value));
+	}
+	return mix64(hash ^ std::hash<double>{}(key.expand));
+}
+
+std::optional<LineOfSightCache::Key>
+LineOfSightCache::make_key(const Query &query) const
+{
+	Key key;
+	int64_t *coordinates[] = {&key.from_x, &key.from_y, &key.to_x, &key.to_y};
+	double values[] = {query.from.x, query.from.y, query.to.x, query.to.y};
+	for (size_t i = 0; i < 4; i++)
+	{
+		double value = values[i];
+		if (m_settings.quantum > 0)
+		{
+			value = std::round(value / m_settings.quantum);
+		}
+		//anything that does not fit is simply not cached
+		if (!std::isfinite(value) || std::abs(value) > 9e18)
+		{
+			return std::nullopt;
+		}
+		*coordinates[i] = m_settings.quantum > 0
+		                      ? static_cast<int64_t>(value)
+		                      : std::bit_cast<int64_t>(value);
+	}
+	key.expand = query.flags.expand;
+	key.flags = query.flags.movement | query.flags.infection << 1
+	            | query.single_precision << 2;
+	return key;
+}
+
+void LineOfSightCache::evict_to(size_t capacity)
+{
+	while (m_entries.size() > capacity)
+	{
+		m_index.erase(m_entries.back().first);
+		m_entries.pop_back();
+		m_stats.evictions++;
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+#include <glm/ext.hpp>
+
+#include "LineOfSight.hpp"
+
+//remembers recent line of sight results of one floor, for people that keep
+//testing (almost) the same segment every tick
+//endpoints are snapped to multiples of quantum before the lookup, so with a
+//non zero quantum a hit can answer for a segment that is up to half a
+//quantum away from the one that was actually tested
+class LineOfSightCache
+{
+	public:
+	struct Settings
+	{
+		bool enabled = false;
+		size_t capacity = 4096;
+		double quantum = 1e-6;
+	};
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+
+		Stats &operator+=(const Stats &other)
+		{
+			hits += other.hits;
+			misses += other.misses;
+			evictions += other.evictions;
+			entries += other.entries;
+			return *this;
+		}
+	};
+	struct Query
+	{
+		glm::dvec2 from;
+		glm::dvec2 to;
+		LineOfSightFlags flags;
+		//single and double precision results are kept apart
+		bool single_precision = false;
+	};
+
+	LineOfSightCache() = default;
+	//copies only the settings and counters, never the entries
+	LineOfSightCache(const LineOfSightCache &other);
+	LineOfSightCache &operator=(const LineOfSightCache &other);
+
+	void configure(Settings settings);
+	Settings settings() const;
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+	//counts a hit or a miss, disabled caches always miss without counting
+	std::optional<bool> find(const Query &query);
+	void insert(const Query &query, bool visible);
+	//drops every entry, has to be called whenever an obstacle changes
+	void clear();
+	//while held finds leave the order of the entries alone and inserts are
+	//dropped, so queries running side by side in any order all see the
+	//cache as it was, see World::calculate_paths
+	void hold(bool held);
+
+	Stats stats() const;
+	void reset_stats();
+
+	private:
+	struct Key
+	{
+		int64_t from_x, from_y, to_x, to_y;
+		double expand;
+		uint8_t flags;
+		bool operator==(const Key &) const = default;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+	using Entry = std::pair<Key, bool>;
+
+	std::optional<Key> make_key(const Query &query) const;
+	void evict_to(size_t capacity);
+
+	mutable std::mutex m_mutex;
+	std::atomic<bool> m_enabled{false};
+	Settings m_settings;
+	//most recently used at the front
+	std::list<Entry> m_entries;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+	Stats m_stats;
+	bool m_held = false;
+};
@@ -0,0 +1,1062 @@
+#include "NavMesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+
+#include "world.hpp"
+
+namespace
+{
+//grid steps along the sides of the box, coordinate differences take 27 bits
+//so the in circle determinant fits in 128
+constexpr int64_t grid_steps = int64_t{1} << 26;
+//a constraint is split at every constrained edge it crosses, the pieces are
+//inserted again and may be split once more, this deep at most
+constexpr int max_split_depth = 32;
+
+double cross(glm::dvec2 a, glm::dvec2 b) { return a.x * b.y - a.y * b.x; }
+
+//true if point is strictly inside the quadrilateral, in either winding
+bool inside(const std::array<glm::dvec2, 4> &corners, glm::dvec2 point)
+{
+	int positive = 0, negative = 0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		auto side = cross(corners[(i + 1) % 4] - corners[i], point - corners[i]);
+		positive += side > 0;
+		negative += side < 0;
+	}
+	return positive == 4 || negative == 4;
+}
+
+//the part from + (to - from) * t of a segment strictly inside the convex
+//quadrilateral, in either winding
+std::optional<std::pair<double, double>> inside_interval(
+    const std::array<glm::dvec2, 4> &corners,
+    glm::dvec2 from,
+    glm::dvec2 to)
+{
+	auto winding = cross(corners[1] - corners[0], corners[2] - corners[0]) < 0
+	                   ? -1.0
+	                   : 1.0;
+	double enter = 0, leave = 1;
+	for (size_t i = 0; i < 4; i++)
+	{
+		auto side = corners[(i + 1) % 4] - corners[i];
+		auto start = cross(side, from - corners[i]) * winding;
+		auto slope = cross(side, to - from) * winding;
+		if (slope == 0)
+		{
+			if (start <= 0)
+			{
+				return std::nullopt;
+			}
+			continue;
+		}
+		auto t = -start / slope;
+		if (slope > 0)
+		{
+			enter = std::max(enter, t);
+		}
+		else
+		{
+			leave = std::min(leave, t);
+		}
+	}
+	if (enter >= leave)
+	{
+		return std::nullopt;
+	}
+	return std::pair{enter, leave};
+}
+
+glm::dvec2 closest_on_segment(glm::dvec2 a, glm::dvec2 b, glm::dvec2 point)
+{
+	auto along = b - a;
+	auto t = std::clamp(glm::dot(point - a, along) / glm::dot(along, along), 0.0, 1.0);
+	return a + along * t;
+}
+
+//the corners of the shortest line through all portals, the (left, right)
+//edges a corridor is crossed at as seen walking along it
+//the first and the last portal are the start and the end, which are left out
+std::vector<glm::dvec2>
+pull_tight(std::span<const std::pair<glm::dvec2, glm::dvec2>> portals)
+{
+	std::vector<glm::dvec2> corners;
+	auto apex = portals[0].first, left = apex, right = apex;
+	size_t apex_index = 0, left_index = 0, right_index = 0;
+	for (size_t i = 1; i < portals.size(); i++)
+	{
+		auto [next_left, next_right] = portals[i];
+		//each side of the funnel only ever narrows, once it would cross the
+		//other side that one is a corner of the path
+		if (cross(right - apex, next_right - apex) >= 0)
+		{
+			if (apex == right || cross(left - apex, next_right - apex) < 0)
+			{
+				right = next_right;
+				right_index = i;
+			}
+			else
+			{
+				corners.push_back(left);
+				apex = right = left;
+				apex_index = right_index = left_index;
+				i = apex_index;
+				continue;
+			}
+		}
+		if (cross(left - apex, next_left - apex) <= 0)
+		{
+			if (apex == left || cross(right - apex, next_left - apex) > 0)
+			{
+				left = next_left;
+				left_index = i;
+			}
+			else
+			{
+				corners.push_back(right);
+				apex = left = right;
+				apex_index = left_index = right_index;
+				i = apex_index;
+				continue;
+			}
+		}
+	}
+	return corners;
+}
+} // namespace
+
+void NavMesh::build(const ObstacleStore &obstacles, const ObstacleGrid &grid)
+{
+	m_positions.clear();
+	m_points.clear();
+	m_vertex_triangle.clear();
+	m_triangles.clear();
+	m_hints.clear();
+
+	//people mostly live on the unit square, so it is always covered
+	glm::dvec2 min{0}, max{1};
+	std::vector<std::array<glm::dvec2, 4>> outlines;
+	std::vector<size_t> outline_ids;
+	for (auto it = obstacles.begin(); it != obstacles.end(); ++it)
+	{
+		if (!it->blocks_movement)
+		{
+			continue;
+		}
+		//obstacles without a size have no outline to go around
+		auto &corners = *it->geometry().find_vertecies(expand);
+		if (!std::ranges::all_of(corners, [](glm::dvec2 corner) {
+			    return std::isfinite(corner.x) && std::isfinite(corner.y);
+		    }))
+		{
+			continue;
+		}
+		outlines.push_back(corners);
+		outline_ids.push_back(it.slot());
+		for (auto &corner : corners)
+		{
+			min = glm::min(min, corner);
+			max = glm::max(max, corner);
+		}
+	}
+
+	//a square box with room to walk around the outermost obstacles, two
+	//triangles to start with
+	auto side = std::max(max.x - min.x, max.y - min.y);
+	m_min = min - side / 8;
+	m_max = m_min + side * 1.25;
+	m_grid_step = side * 1.25 / grid_steps;
+	for (auto corner :
+	     {m_min, glm::dvec2{m_max.x, m_min.y}, m_max, glm::dvec2{m_min.x, m_max.y}})
+	{
+		m_positions.push_back(corner);
+		m_points.push_back(to_grid(corner));
+	}
+	m_vertex_triangle = {0, 0, 0, 1};
+	m_triangles.push_back({{0, 1, 2}, {none, 1, none}, {}});
+	m_triangles.push_back({{0, 2, 3}, {none, none, 0}, {}});
+	m_last_triangle = 0;
+
+	//only the outline of the union of the obstacles matters, the parts of
+	//outlines inside other obstacles are left out
+	//dense layouts overlap a lot and every crossing of two outlines would
+	//be a vertex otherwise
+	std::vector<uint32_t> outline_of(obstacles.slot_limit(), none);
+	for (uint32_t outline = 0; outline < outlines.size(); outline++)
+	{
+		outline_of[outline_ids[outline]] = outline;
+	}
+	//the grid hands out an obstacle once for every cell it shares with the
+	//segment
+	std::vector<uint32_t> visited(obstacles.slot_limit(), none);
+	uint32_t query = 0;
+	auto blocked_parts = [&](uint32_t outline, glm::dvec2 from, glm::dvec2 to) {
+		std::vector<std::pair<double, double>> parts;
+		query++;
+		grid.for_each_candidate(from, to, [&](size_t id) {
+			auto other = outline_of[id];
+			if (other == none || other == outline || visited[id] == query)
+			{
+				return true;
+			}
+			visited[id] = query;
+			if (auto part = inside_interval(outlines[other], from, to))
+			{
+				parts.push_back(*part);
+				//nothing of it is left
+				return part->first > 0 || part->second < 1;
+			}
+			return true;
+		});
+		std::sort(parts.begin(), parts.end());
+		return parts;
+	};
+
+	//corners near each other are inserted one after another, which keeps
+	//the walks to them short, outlines too
+	auto cells = std::max<int64_t>(
+	    1,
+	    static_cast<int64_t>(std::sqrt(static_cast<double>(outlines.size()))));
+	auto cell_order = [&](glm::dvec2 position) {
+		auto point = to_grid(position);
+		auto column = std::min(point.x * cells / grid_steps, cells - 1);
+		auto row = std::min(point.y * cells / grid_steps, cells - 1);
+		//every other row backwards
+		return row * cells + (row % 2 ? cells - 1 - column : column);
+	};
+	std::vector<std::pair<int64_t, uint32_t>> order;
+	order.reserve(outlines.size() * 4);
+	for (uint32_t corner = 0; corner < outlines.size() * 4; corner++)
+	{
+		auto position = outlines[corner / 4][corner % 4];
+		if (blocked_parts(corner / 4, position, position).empty())
+		{
+			order.emplace_back(cell_order(position), corner);
+		}
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<uint32_t> corner_vertex(outlines.size() * 4, none);
+	for (auto [key, corner] : order)
+	{
+		corner_vertex[corner] = insert_vertex(outlines[corner / 4][corner % 4]);
+	}
+	order.clear();
+	for (uint32_t outline = 0; outline < outlines.size(); outline++)
+	{
+		order.emplace_back(cell_order(outlines[outline][0]), outline);
+	}
+	std::sort(order.begin(), order.end());
+	for (auto [key, outline] : order)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			auto from = outlines[outline][i];
+			auto to = outlines[outline][(i + 1) % 4];
+			auto vertex_at = [&](double t) {
+				if (t == 0 && corner_vertex[outline * 4 + i] != none)
+				{
+					return corner_vertex[outline * 4 + i];
+				}
+				if (t == 1
+				    && corner_vertex[outline * 4 + (i + 1) % 4] != none)
+				{
+					return corner_vertex[outline * 4 + (i + 1) % 4];
+				}
+				return insert_vertex(from + (to - from) * t);
+			};
+			//the free pieces between the blocked parts
+			double free_from = 0;
+			auto parts = blocked_parts(outline, from, to);
+			parts.emplace_back(1, 1);
+			for (auto [enter, leave] : parts)
+			{
+				if (enter > free_from
+				    && to_grid(from + (to - from) * free_from)
+				           != to_grid(from + (to - from) * enter))
+				{
+					insert_constraint(vertex_at(free_from), vertex_at(enter), 0);
+				}
+				free_from = std::max(free_from, leave);
+			}
+		}
+	}
+
+	//no triangle crosses an outline, so its middle decides
+	for (auto &triangle : m_triangles)
+	{
+		auto center = (m_positions[triangle.vertecies[0]]
+		               + m_positions[triangle.vertecies[1]]
+		               + m_positions[triangle.vertecies[2]])
+		              / 3.0;
+		triangle.walkable
+		    = grid.for_each_candidate(center, center, [&](size_t id) {
+			      auto &obstacle = obstacles[id];
+			      return !obstacle.blocks_movement
+			             || !inside(
+			                 *obstacle.geometry().find_vertecies(expand),
+			                 center);
+		      });
+	}
+
+	m_hint_columns = std::clamp(
+	    static_cast<int>(std::sqrt(m_triangles.size() / 8.0)),
+	    1,
+	    1024);
+	m_hints.resize(static_cast<size_t>(m_hint_columns) * m_hint_columns);
+	uint32_t previous = 0;
+	for (int row = 0; row < m_hint_columns; row++)
+	{
+		for (int column = 0; column < m_hint_columns; column++)
+		{
+			GridPoint middle{
+			    (2 * column + 1) * grid_steps / (2 * m_hint_columns),
+			    (2 * row + 1) * grid_steps / (2 * m_hint_columns)};
+			previous = locate(middle, previous);
+			m_hints[static_cast<size_t>(row) * m_hint_columns + column]
+			    = previous;
+		}
+	}
+}
+
+std::optional<std::pair<std::vector<glm::dvec2>, size_t>>
+NavMesh::find_path(glm::dvec2 start, std::span<const glm::dvec2> ends) const
+{
+	if (m_triangles.empty())
+	{
+		return std::nullopt;
+	}
+	auto from = enter(start);
+	if (!from)
+	{
+		return std::nullopt;
+	}
+	std::vector<std::optional<Entry>> to;
+	std::unordered_map<uint32_t, std::vector<size_t>> ends_in;
+	for (size_t end = 0; end < ends.size(); end++)
+	{
+		to.push_back(enter(ends[end]));
+		if (to.back())
+		{
+			ends_in[to.back()->triangle].push_back(end);
+		}
+	}
+	if (ends_in.empty())
+	{
+		return std::nullopt;
+	}
+	auto heuristic = [&](glm::dvec2 point) {
+		auto nearest = std::numeric_limits<double>::infinity();
+		for (auto &entry : to)
+		{
+			if (entry)
+			{
+				nearest = std::min(nearest, glm::distance(point, entry->point));
+			}
+		}
+		return nearest;
+	};
+
+	//A* over the triangles, each one is entered at the point of the shared
+	//edge nearest to where the path came from
+	//ids past the triangles stand for ends[id - goal_offset] being reached
+	struct Node
+	{
+		double g;
+		uint32_t parent;
+		glm::dvec2 point;
+		bool closed = false;
+	};
+	std::unordered_map<uint32_t, Node> nodes;
+	using Candidate = std::pair<double, uint32_t>;
+	std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> open;
+	auto goal_offset = static_cast<uint32_t>(m_triangles.size());
+	std::vector<double> end_g(
+	    ends.size(),
+	    std::numeric_limits<double>::infinity());
+	std::optional<size_t> reached;
+	nodes.emplace(from->triangle, Node{0, none, from->point});
+	open.emplace(heuristic(from->point), from->triangle);
+	while (!open.empty())
+	{
+		auto id = open.top().second;
+		open.pop();
+		if (id >= goal_offset)
+		{
+			reached = id - goal_offset;
+			break;
+		}
+		auto &node = nodes.at(id);
+		if (node.closed)
+		{
+			continue;
+		}
+		node.closed = true;
+		auto g = node.g;
+		auto point = node.point;
+		if (auto found = ends_in.find(id); found != ends_in.end())
+		{
+			for (auto end : found->second)
+			{
+				auto end_cost = g + glm::distance(point, to[end]->point);
+				if (end_cost < end_g[end])
+				{
+					end_g[end] = end_cost;
+					open.emplace(end_cost, goal_offset + end);
+				}
+			}
+		}
+		auto &triangle = m_triangles[id];
+		for (size_t edge = 0; edge < 3; edge++)
+		{
+			auto neighbour = triangle.neighbours[edge];
+			if (neighbour == none || !m_triangles[neighbour].walkable)
+			{
+				continue;
+			}
+			auto entry = closest_on_segment(
+			    m_positions[triangle.vertecies[(edge + 1) % 3]],
+			    m_positions[triangle.vertecies[(edge + 2) % 3]],
+			    point);
+			auto entry_g = g + glm::distance(point, entry);
+			auto [existing, added]
+			    = nodes.try_emplace(neighbour, Node{entry_g, id, entry});
+			if (!added)
+			{
+				if (existing->second.closed || existing->second.g <= entry_g)
+				{
+					continue;
+				}
+				existing->second = Node{entry_g, id, entry};
+			}
+			open.emplace(entry_g + heuristic(entry), neighbour);
+		}
+	}
+	if (!reached)
+	{
+		return std::nullopt;
+	}
+
+	auto &goal = *to[*reached];
+	std::vector<uint32_t> corridor;
+	for (auto id = goal.triangle; id != none; id = nodes.at(id).parent)
+	{
+		corridor.push_back(id);
+	}
+	std::reverse(corridor.begin(), corridor.end());
+	std::vector<std::pair<glm::dvec2, glm::dvec2>> portals{
+	    {from->point, from->point}};
+	for (size_t i = 0; i + 1 < corridor.size(); i++)
+	{
+		//the triangle is on the left of each of its counter clockwise
+		//edges, so walking out over one its end is on the left
+		auto &vertecies = m_triangles[corridor[i]].vertecies;
+		auto edge = neighbour_index(corridor[i], corridor[i + 1]);
+		portals.emplace_back(
+		    m_positions[vertecies[(edge + 2) % 3]],
+		    m_positions[vertecies[(edge + 1) % 3]]);
+	}
+	portals.emplace_back(goal.point, goal.point);
+
+	std::vector<glm::dvec2> path{start};
+	auto add = [&](glm::dvec2 point) {
+		if (point != path.back())
+		{
+			path.push_back(point);
+		}
+	};
+	add(from->point);
+	for (auto corner : pull_tight(portals))
+	{
+		add(corner);
+	}
+	add(goal.point);
+	path.push_back(ends[*reached]);
+	return std::pair{std::move(path), *reached};
+}
+
+bool NavMesh::walkable(glm::dvec2 point) const
+{
+	if (m_triangles.empty())
+	{
+		return true;
+	}
+	auto grid_point = to_grid(glm::clamp(point, m_min, m_max));
+	return m_triangles[locate(grid_point, hint(grid_point))].walkable;
+}
+
+size_t NavMesh::memory_bytes() const
+{
+	return m_positions.capacity() * sizeof(glm::dvec2)
+	       + m_points.capacity() * sizeof(GridPoint)
+	       + m_vertex_triangle.capacity() * sizeof(uint32_t)
+	       + m_triangles.capacity() * sizeof(Triangle)
+	       + m_hints.capacity() * sizeof(uint32_t);
+}
+
+int64_t NavMesh::orient(GridPoint a, GridPoint b, GridPoint c)
+{
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool NavMesh::in_circle(GridPoint a, GridPoint b, GridPoint c, GridPoint d)
+{
+	using wide = __int128;
+	wide adx = a.x - d.x, ady = a.y - d.y;
+	wide bdx = b.x - d.x, bdy = b.y - d.y;
+	wide cdx = c.x - d.x, cdy = c.y - d.y;
+	auto a_lift = adx * adx + ady * ady;
+	auto b_lift = bdx * bdx + bdy * bdy;
+	auto c_lift = cdx * cdx + cdy * cdy;
+	return a_lift * (bdx * cdy - cdx * bdy) + b_lift * (cdx * ady - adx * cdy)
+	           + c_lift * (adx * bdy - bdx * ady)
+	       > 0;
+}
+
+NavMesh::GridPoint NavMesh::to_grid(glm::dvec2 position) const
+{
+	auto scaled = glm::round((position - m_min) / m_grid_step);
+	return {
+	    std::clamp(static_cast<int64_t>(scaled.x), int64_t{0}, grid_steps),
+	    std::clamp(static_cast<int64_t>(scaled.y), int64_t{0}, grid_steps)};
+}
+
+uint32_t NavMesh::locate(GridPoint point, uint32_t start) const
+{
+	//steps over an edge point is behind, trying the edges in a varying
+	//order so the walk can not go in circles
+	auto triangle = start;
+	uint32_t random = 2463534242u;
+	while (true)
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		auto &current = m_triangles[triangle];
+		auto next = none;
+		for (size_t i = 0; i < 3 && next == none; i++)
+		{
+			auto edge = (random + i) % 3;
+			if (orient(
+			        m_points[current.vertecies[(edge + 1) % 3]],
+			        m_points[current.vertecies[(edge + 2) % 3]],
+			        point)
+			    < 0)
+			{
+				next = current.neighbours[edge];
+			}
+		}
+		if (next == none)
+		{
+			return triangle;
+		}
+		triangle = next;
+	}
+}
+
+uint32_t NavMesh::hint(GridPoint point) const
+{
+	auto cell = [&](int64_t coordinate) {
+		return std::min<int64_t>(
+		    coordinate * m_hint_columns / grid_steps,
+		    m_hint_columns - 1);
+	};
+	return m_hints[cell(point.y) * m_hint_columns + cell(point.x)];
+}
+
+uint32_t NavMesh::insert_vertex(glm::dvec2 position)
+{
+	auto point = to_grid(position);
+	auto triangle = locate(point, m_last_triangle);
+	m_last_triangle = triangle;
+	auto vertecies = m_triangles[triangle].vertecies;
+	for (auto vertex : vertecies)
+	{
+		if (m_points[vertex] == point)
+		{
+			return vertex;
+		}
+	}
+	auto vertex = static_cast<uint32_t>(m_positions.size());
+	m_positions.push_back(position);
+	m_points.push_back(point);
+	m_vertex_triangle.push_back(triangle);
+	for (size_t edge = 0; edge < 3; edge++)
+	{
+		if (orient(
+		        m_points[vertecies[(edge + 1) % 3]],
+		        m_points[vertecies[(edge + 2) % 3]],
+		        point)
+		    == 0)
+		{
+			split_edge(triangle, edge, vertex);
+			return vertex;
+		}
+	}
+	split_triangle(triangle, vertex);
+	return vertex;
+}
+
+void NavMesh::split_triangle(uint32_t triangle, uint32_t vertex)
+{
+	auto [a, b, c] = m_triangles[triangle].vertecies;
+	auto [across_bc, across_ca, across_ab] = m_triangles[triangle].neighbours;
+	auto [along_bc, along_ca, along_ab] = m_triangles[triangle].constrained;
+	auto first = static_cast<uint32_t>(m_triangles.size());
+	auto second = first + 1;
+	m_triangles[triangle]
+	    = {{vertex, b, c}, {across_bc, first, second}, {along_bc, false, false}};
+	m_triangles.push_back(
+	    {{vertex, c, a}, {across_ca, second, triangle}, {along_ca, false, false}});
+	m_triangles.push_back(
+	    {{vertex, a, b}, {across_ab, triangle, first}, {along_ab, false, false}});
+	replace_neighbour(across_ca, triangle, first);
+	replace_neighbour(across_ab, triangle, second);
+	m_vertex_triangle[vertex] = triangle;
+	m_vertex_triangle[a] = first;
+	m_vertex_triangle[b] = triangle;
+	m_vertex_triangle[c] = triangle;
+	std::vector<std::pair<uint32_t, size_t>> stack{
+	    {triangle, 0},
+	    {first, 0},
+	    {second, 0}};
+	legalize(stack);
+}
+
+void NavMesh::split_edge(uint32_t triangle, size_t edge, uint32_t vertex)
+{
+	//vertex is on b - c, the other triangle there has d opposite of it
+	auto &split = m_triangles[triangle];
+	auto a = split.vertecies[edge];
+	auto b = split.vertecies[(edge + 1) % 3];
+	auto c = split.vertecies[(edge + 2) % 3];
+	auto across_ca = split.neighbours[(edge + 1) % 3];
+	auto across_ab = split.neighbours[(edge + 2) % 3];
+	auto along_ca = split.constrained[(edge + 1) % 3];
+	auto along_ab = split.constrained[(edge + 2) % 3];
+	auto along_bc = split.constrained[edge];
+	auto other = split.neighbours[edge];
+	auto first = static_cast<uint32_t>(m_triangles.size());
+	auto second = first + 1;
+	std::vector<std::pair<uint32_t, size_t>> stack{{triangle, 2}, {first, 1}};
+	if (other == none)
+	{
+		m_triangles[triangle]
+		    = {{a, b, vertex}, {none, first, across_ab}, {along_bc, false, along_ab}};
+		m_triangles.push_back(
+		    {{a, vertex, c}, {none, across_ca, triangle}, {along_bc, along_ca, false}});
+	}
+	else
+	{
+		auto &opposite = m_triangles[other];
+		auto j = neighbour_index(other, triangle);
+		auto d = opposite.vertecies[j];
+		auto across_bd = opposite.neighbours[(j + 1) % 3];
+		auto across_dc = opposite.neighbours[(j + 2) % 3];
+		auto along_bd = opposite.constrained[(j + 1) % 3];
+		auto along_dc = opposite.constrained[(j + 2) % 3];
+		m_triangles[triangle] = {
+		    {a, b, vertex},
+		    {second, first, across_ab},
+		    {along_bc, false, along_ab}};
+		m_triangles[other] = {
+		    {d, c, vertex},
+		    {first, second, across_dc},
+		    {along_bc, false, along_dc}};
+		m_triangles.push_back(
+		    {{a, vertex, c}, {other, across_ca, triangle}, {along_bc, along_ca, false}});
+		m_triangles.push_back(
+		    {{d, vertex, b}, {triangle, across_bd, other}, {along_bc, along_bd, false}});
+		replace_neighbour(across_bd, other, second);
+		m_vertex_triangle[d] = other;
+		stack.emplace_back(other, 2);
+		stack.emplace_back(second, 1);
+	}
+	replace_neighbour(across_ca, triangle, first);
+	m_vertex_triangle[vertex] = triangle;
+	m_vertex_triangle[a] = triangle;
+	m_vertex_triangle[b] = triangle;
+	m_vertex_triangle[c] = first;
+	legalize(stack);
+}
+
+void NavMesh::legalize(std::vector<std::pair<uint32_t, size_t>> &stack)
+{
+	while (!stack.empty())
+	{
+		auto [triangle, corner] = stack.back();
+		stack.pop_back();
+		auto &current = m_triangles[triangle];
+		auto other = current.neighbours[corner];
+		if (other == none || current.constrained[corner])
+		{
+			continue;
+		}
+		auto opposite
+		    = m_triangles[other].vertecies[neighbour_index(other, triangle)];
+		if (!in_circle(
+		        m_points[current.vertecies[0]],
+		        m_points[current.vertecies[1]],
+		        m_points[current.vertecies[2]],
+		        m_points[opposite]))
+		{
+			continue;
+		}
+		//the new vertex ends up first in triangle and last in other
+		flip(triangle, corner);
+		stack.emplace_back(triangle, 0);
+		stack.emplace_back(other, 2);
+	}
+}
+
+void NavMesh::flip(uint32_t triangle, size_t edge)
+{
+	//triangle is a, b, c and other d, c, b, afterwards they are a, b, d and
+	//d, c, a
+	auto &first = m_triangles[triangle];
+	auto other = first.neighbours[edge];
+	auto &second = m_triangles[other];
+	auto j = neighbour_index(other, triangle);
+	auto a = first.vertecies[edge];
+	auto b = first.vertecies[(edge + 1) % 3];
+	auto c = first.vertecies[(edge + 2) % 3];
+	auto d = second.vertecies[j];
+	auto across_ca = first.neighbours[(edge + 1) % 3];
+	auto across_ab = first.neighbours[(edge + 2) % 3];
+	auto along_ca = first.constrained[(edge + 1) % 3];
+	auto along_ab = first.constrained[(edge + 2) % 3];
+	auto across_bd = second.neighbours[(j + 1) % 3];
+	auto across_dc = second.neighbours[(j + 2) % 3];
+	auto along_bd = second.constrained[(j + 1) % 3];
+	auto along_dc = second.constrained[(j + 2) % 3];
+	first.vertecies = {a, b, d};
+	first.neighbours = {across_bd, other, across_ab};
+	first.constrained = {along_bd, false, along_ab};
+	second.vertecies = {d, c, a};
+	second.neighbours = {across_ca, triangle, across_dc};
+	second.constrained = {along_ca, false, along_dc};
+	replace_neighbour(across_bd, other, triangle);
+	replace_neighbour(across_ca, triangle, other);
+	m_vertex_triangle[a] = triangle;
+	m_vertex_triangle[b] = triangle;
+	m_vertex_triangle[c] = other;
+	m_vertex_triangle[d] = triangle;
+}
+
+void NavMesh::replace_neighbour(uint32_t triangle, uint32_t from, uint32_t to)
+{
+	if (triangle == none)
+	{
+		return;
+	}
+	for (auto &neighbour : m_triangles[triangle].neighbours)
+	{
+		if (neighbour == from)
+		{
+			neighbour = to;
+		}
+	}
+}
+
+size_t NavMesh::index_of(uint32_t triangle, uint32_t vertex) const
+{
+	auto &vertecies = m_triangles[triangle].vertecies;
+	return std::ranges::find(vertecies, vertex) - vertecies.begin();
+}
+
+size_t NavMesh::neighbour_index(uint32_t triangle, uint32_t neighbour) const
+{
+	auto &neighbours = m_triangles[triangle].neighbours;
+	return std::ranges::find(neighbours, neighbour) - neighbours.begin();
+}
+
+template <typename Visit>
+void NavMesh::for_each_around(uint32_t vertex, Visit &&visit) const
+{
+	auto start = m_vertex_triangle[vertex];
+	auto triangle = start;
+	do
+	{
+		auto corner = index_of(triangle, vertex);
+		if (!visit(triangle, corner))
+		{
+			return;
+		}
+		triangle = m_triangles[triangle].neighbours[(corner + 1) % 3];
+	} while (triangle != none && triangle != start);
+	if (triangle == start)
+	{
+		return;
+	}
+	//a vertex on the side of the box, the rest is the other way round
+	triangle = m_triangles[start].neighbours[(index_of(start, vertex) + 2) % 3];
+	while (triangle != none)
+	{
+		auto corner = index_of(triangle, vertex);
+		if (!visit(triangle, corner))
+		{
+			return;
+		}
+		triangle = m_triangles[triangle].neighbours[(corner + 2) % 3];
+	}
+}
+
+std::pair<uint32_t, size_t> NavMesh::find_edge(uint32_t a, uint32_t b) const
+{
+	std::pair<uint32_t, size_t> found{none, 0};
+	for_each_around(a, [&](uint32_t triangle, size_t corner) {
+		auto &vertecies = m_triangles[triangle].vertecies;
+		if (vertecies[(corner + 1) % 3] == b)
+		{
+			found = {triangle, (corner + 2) % 3};
+			return false;
+		}
+		if (vertecies[(corner + 2) % 3] == b)
+		{
+			found = {triangle, (corner + 1) % 3};
+			return false;
+		}
+		return true;
+	});
+	return found;
+}
+
+void NavMesh::set_constrained(uint32_t triangle, size_t edge, bool constrained)
+{
+	m_triangles[triangle].constrained[edge] = constrained;
+	auto other = m_triangles[triangle].neighbours[edge];
+	if (other != none)
+	{
+		m_triangles[other].constrained[neighbour_index(other, triangle)]
+		    = constrained;
+	}
+}
+
+void NavMesh::insert_constraint(uint32_t a, uint32_t b, int depth)
+{
+	if (a == b)
+	{
+		return;
+	}
+	auto point_a = m_points[a], point_b = m_points[b];
+	//the edge itself, a vertex on the segment or the triangle around a the
+	//segment leaves it through
+	auto existing = find_edge(a, b);
+	if (existing.first != none)
+	{
+		set_constrained(existing.first, existing.second, true);
+		return;
+	}
+	auto through = none, first = none;
+	size_t first_corner = 0;
+	for_each_around(a, [&](uint32_t triangle, size_t corner) {
+		auto &vertecies = m_triangles[triangle].vertecies;
+		auto right = vertecies[(corner + 1) % 3];
+		auto left = vertecies[(corner + 2) % 3];
+		for (auto vertex : {right, left})
+		{
+			auto point = m_points[vertex];
+			if (orient(point_a, point_b, point) == 0
+			    && (point.x - point_a.x) * (point_b.x - point_a.x)
+			               + (point.y - point_a.y) * (point_b.y - point_a.y)
+			           > 0)
+			{
+				through = vertex;
+				return false;
+			}
+		}
+		if (orient(point_a, m_points[right], point_b) > 0
+		    && orient(point_a, point_b, m_points[left]) > 0)
+		{
+			first = triangle;
+			first_corner = corner;
+			return false;
+		}
+		return true;
+	});
+	if (through != none)
+	{
+		insert_constraint(a, through, depth);
+		insert_constraint(through, b, depth);
+		return;
+	}
+	if (first == none)
+	{
+		return;
+	}
+
+	//walks along the segment collecting the edges it crosses, right of it
+	//first
+	std::deque<std::pair<uint32_t, uint32_t>> crossed;
+	auto triangle = first;
+	auto edge = first_corner;
+	while (true)
+	{
+		auto &current = m_triangles[triangle];
+		auto right = current.vertecies[(edge + 1) % 3];
+		auto left = current.vertecies[(edge + 2) % 3];
+		if (current.constrained[edge])
+		{
+			//crossing another outline, both are split where they meet
+			if (depth >= max_split_depth)
+			{
+				return;
+			}
+			auto side_a = orient(m_points[right], m_points[left], point_a);
+			auto side_b = orient(m_points[right], m_points[left], point_b);
+			auto at = static_cast<double>(side_a)
+			          / (static_cast<double>(side_a) - static_cast<double>(side_b));
+			set_constrained(triangle, edge, false);
+			auto split
+			    = insert_vertex(glm::mix(m_positions[a], m_positions[b], at));
+			insert_constraint(right, split, depth + 1);
+			insert_constraint(split, left, depth + 1);
+			insert_constraint(a, split, depth + 1);
+			insert_constraint(split, b, depth + 1);
+			return;
+		}
+		crossed.emplace_back(right, left);
+		auto next = current.neighbours[edge];
+		auto j = neighbour_index(next, triangle);
+		auto vertex = m_triangles[next].vertecies[j];
+		if (vertex == b)
+		{
+			break;
+		}
+		auto side = orient(point_a, point_b, m_points[vertex]);
+		if (side == 0)
+		{
+			insert_constraint(a, vertex, depth);
+			insert_constraint(vertex, b, depth);
+			return;
+		}
+		//next is vertex, left, right
+		triangle = next;
+		edge = side < 0 ? (j + 2) % 3 : (j + 1) % 3;
+	}
+
+	//flips the crossed edges away, one of them always has a convex
+	//quadrilateral around it
+	auto crosses = [&](uint32_t c, uint32_t d) {
+		return c != a && c != b && d != a && d != b
+		       && (orient(point_a, point_b, m_points[c]) > 0)
+		              != (orient(point_a, point_b, m_points[d]) > 0);
+	};
+	std::vector<std::pair<uint32_t, uint32_t>> created;
+	while (!crossed.empty())
+	{
+		auto [c, d] = crossed.front();
+		crossed.pop_front();
+		auto [at, corner] = find_edge(c, d);
+		if (at == none)
+		{
+			continue;
+		}
+		auto other = m_triangles[at].neighbours[corner];
+		auto e = m_triangles[at].vertecies[corner];
+		auto f = m_triangles[other].vertecies[neighbour_index(other, at)];
+		auto side_c = orient(m_points[e], m_points[f], m_points[c]);
+		auto side_d = orient(m_points[e], m_points[f], m_points[d]);
+		if (!((side_c > 0 && side_d < 0) || (side_c < 0 && side_d > 0)))
+		{
+			crossed.emplace_back(c, d);
+			continue;
+		}
+		flip(at, corner);
+		if (crosses(e, f))
+		{
+			crossed.emplace_back(e, f);
+		}
+		else
+		{
+			created.emplace_back(e, f);
+		}
+	}
+	existing = find_edge(a, b);
+	if (existing.first != none)
+	{
+		set_constrained(existing.first, existing.second, true);
+	}
+
+	//the new edges other than a - b are made Delaunay again
+	for (bool flipped = true; flipped;)
+	{
+		flipped = false;
+		for (auto &[c, d] : created)
+		{
+			auto [at, corner] = find_edge(c, d);
+			if (at == none || m_triangles[at].constrained[corner])
+			{
+				continue;
+			}
+			auto &current = m_triangles[at];
+			auto other = current.neighbours[corner];
+			auto f = m_triangles[other].vertecies[neighbour_index(other, at)];
+			if (!in_circle(
+			        m_points[current.vertecies[0]],
+			        m_points[current.vertecies[1]],
+			        m_points[current.vertecies[2]],
+			        m_points[f]))
+			{
+				continue;
+			}
+			auto e = current.vertecies[corner];
+			flip(at, corner);
+			c = e;
+			d = f;
+			flipped = true;
+		}
+	}
+}
+
+std::optional<NavMesh::Entry> NavMesh::enter(glm::dvec2 point) const
+{
+	//there are no obstacles outside of the box, so the way to it is free
+	auto inside_box = glm::clamp(point, m_min, m_max);
+	auto grid_point = to_grid(inside_box);
+	auto triangle = locate(grid_point, hint(grid_point));
+	if (m_triangles[triangle].walkable)
+	{
+		return Entry{triangle, inside_box};
+	}
+
+	//in the margin around an obstacle, steps out over the nearest edge of
+	//the blocked triangles around point
+	constexpr size_t max_blocked = 64;
+	std::vector<uint32_t> blocked{triangle};
+	std::optional<Entry> nearest;
+	auto nearest_distance = std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i < blocked.size() && i < max_blocked; i++)
+	{
+		auto &current = m_triangles[blocked[i]];
+		for (size_t edge = 0; edge < 3; edge++)
+		{
+			auto neighbour = current.neighbours[edge];
+			if (neighbour == none || std::ranges::find(blocked, neighbour) != blocked.end())
+			{
+				continue;
+			}
+			if (!m_triangles[neighbour].walkable)
+			{
+				blocked.push_back(neighbour);
+				continue;
+			}
+			auto exit = closest_on_segment(
+			    m_positions[current.vertecies[(edge + 1) % 3]],
+			    m_positions[current.vertecies[(edge + 2) % 3]],
+			    inside_box);
+			if (auto distance = glm::distance(inside_box, exit);
+			    distance < nearest_distance)
+			{
+				nearest = Entry{neighbour, exit};
+				nearest_distance = distance;
+			}
+		}
+	}
+	return nearest;
+}
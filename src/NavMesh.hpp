@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "ObstacleGrid.hpp"
+#include "ObstacleStore.hpp"
+
+//constrained Delaunay triangulation of a box around a floor, the outline of
+//the union of the blocks_movement obstacles expanded by the pathing margin
+//is made of edges of it and the triangles inside are blocked
+//a path is a corridor of free triangles found by A* and pulled tight through
+//it, so it bends at the same expanded corners the visibility graph uses but
+//is not always the shortest one
+//size and build time grow about linearly with the obstacles, where the
+//visibility graph grows quadratically
+class NavMesh
+{
+	public:
+	//the outlines are the obstacles expanded by this, like the visibility
+	//graph's vertecies
+	static constexpr double expand = 0.011;
+
+	//the grid has to index obstacles
+	void build(const ObstacleStore &obstacles, const ObstacleGrid &grid);
+
+	//start first and the end reached last, along with its index in ends,
+	//like AStar::path_result
+	//a start or end in the margin around an obstacle first steps out of it
+	std::optional<std::pair<std::vector<glm::dvec2>, size_t>>
+	find_path(glm::dvec2 start, std::span<const glm::dvec2> ends) const;
+	//false inside an obstacle expanded by expand
+	bool walkable(glm::dvec2 point) const;
+
+	size_t vertex_count() const { return m_positions.size(); }
+	size_t triangle_count() const { return m_triangles.size(); }
+	//bytes allocated for the arrays
+	size_t memory_bytes() const;
+
+	private:
+	static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+
+	//a position rounded onto the grid the predicates work on, those are
+	//exact there
+	struct GridPoint
+	{
+		int64_t x, y;
+		bool operator==(const GridPoint &other) const = default;
+	};
+	struct Triangle
+	{
+		//counter clockwise
+		std::array<uint32_t, 3> vertecies;
+		//neighbours[i] shares the edge opposite of vertecies[i], none on
+		//the outside of the box
+		std::array<uint32_t, 3> neighbours;
+		//edges along an obstacle outline
+		std::array<bool, 3> constrained;
+		bool walkable = true;
+	};
+	//a free triangle and the point a path enters or leaves it at
+	struct Entry
+	{
+		uint32_t triangle = none;
+		glm::dvec2 point;
+	};
+
+	//> 0 if c is to the left of a -> b
+	static int64_t orient(GridPoint a, GridPoint b, GridPoint c);
+	//true if d is strictly inside the circle through the counter clockwise
+	//a, b and c
+	static bool in_circle(GridPoint a, GridPoint b, GridPoint c, GridPoint d);
+
+	GridPoint to_grid(glm::dvec2 position) const;
+	uint32_t locate(GridPoint point, uint32_t start) const;
+	uint32_t hint(GridPoint point) const;
+	//the vertex at position, added if there is none yet
+	uint32_t insert_vertex(glm::dvec2 position);
+	void split_triangle(uint32_t triangle, uint32_t vertex);
+	void split_edge(uint32_t triangle, size_t edge, uint32_t vertex);
+	//restores the Delaunay property around freshly added vertecies, the
+	//stack holds triangles and the index of the new vertex in them
+	void legalize(std::vector<std::pair<uint32_t, size_t>> &stack);
+	//swaps the edge opposite of vertecies[edge] for the other diagonal of
+	//the two triangles
+	void flip(uint32_t triangle, size_t edge);
+	void replace_neighbour(uint32_t triangle, uint32_t from, uint32_t to);
+	size_t index_of(uint32_t triangle, uint32_t vertex) const;
+	size_t neighbour_index(uint32_t triangle, uint32_t neighbour) const;
+	//visit(triangle, index of vertex) for the triangles around vertex until
+	//it returns false
+	template <typename Visit>
+	void for_each_around(uint32_t vertex, Visit &&visit) const;
+	//the triangle with the edge a - b and the index of its third vertex
+	std::pair<uint32_t, size_t> find_edge(uint32_t a, uint32_t b) const;
+	void set_constrained(uint32_t triangle, size_t edge, bool constrained);
+	//makes a - b an edge of the mesh, splitting it at vertecies on it and at
+	//constrained edges crossing it
+	void insert_constraint(uint32_t a, uint32_t b, int depth);
+
+	std::optional<Entry> enter(glm::dvec2 point) const;
+
+	//the box the mesh covers
+	glm::dvec2 m_min{0}, m_max{0};
+	double m_grid_step = 1;
+
+	std::vector<glm::dvec2> m_positions;
+	std::vector<GridPoint> m_points;
+	//a triangle using each vertex
+	std::vector<uint32_t> m_vertex_triangle;
+	std::vector<Triangle> m_triangles;
+	//where walks start while building
+	uint32_t m_last_triangle = 0;
+	//a triangle near the middle of every cell of a grid over the box, where
+	//point lookups start, row major
+	int m_hint_columns = 0;
+	std::vector<uint32_t> m_hints;
+};
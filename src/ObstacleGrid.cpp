@@ -0,0 +1,182 @@
+#include "ObstacleGrid.hpp"
+
+#include <optional>
+
+#include "world.hpp"
+
+static_assert(
+    std::ranges::find(ObstacleGeometry::cached_expands, ObstacleGrid::max_expand)
+        != ObstacleGeometry::cached_expands.end(),
+    "the grid reads the max_expand corners straight from the geometry cache");
+
+namespace
+{
+//keeps a floor with a handful of huge obstacles from allocating silly grids
+constexpr int max_cells_per_axis = 1024;
+
+thread_local std::vector<uint32_t> visit_stamps;
+thread_local uint32_t current_stamp = 0;
+
+//the region every expand in [0, max_expand] can reach, the expanded corners
+//move linearly with expand so the two extremes cover the rest
+std::optional<std::pair<glm::dvec2, glm::dvec2>>
+padded_bounds(const Obstacle &obstacle)
+{
+	glm::dvec2 min{std::numeric_limits<double>::max()};
+	glm::dvec2 max{std::numeric_limits<double>::lowest()};
+	auto &geometry = obstacle.geometry();
+	for (auto expand : {0.0, ObstacleGrid::max_expand})
+	{
+		for (auto &vertex : *geometry.find_vertecies(expand))
+		{
+			min = glm::min(min, vertex);
+			max = glm::max(max, vertex);
+		}
+	}
+	if (!std::isfinite(min.x) || !std::isfinite(min.y) || !std::isfinite(max.x)
+	    || !std::isfinite(max.y))
+	{
+		return std::nullopt;
+	}
+	return std::pair{min - intersect_margin, max + intersect_margin};
+}
+} // namespace
+
+std::pair<uint32_t *, uint32_t> ObstacleGrid::begin_visit(size_t obstacle_count)
+{
+	if (visit_stamps.size() < obstacle_count)
+	{
+		visit_stamps.resize(obstacle_count, 0);
+	}
+	current_stamp++;
+	if (current_stamp == 0)
+	{
+		std::fill(visit_stamps.begin(), visit_stamps.end(), 0);
+		current_stamp = 1;
+	}
+	return {visit_stamps.data(), current_stamp};
+}
+
+void ObstacleGrid::build(const ObstacleStore &obstacles)
+{
+	m_cells.clear();
+	m_unbounded.clear();
+	m_placements.assign(obstacles.slot_limit(), {});
+	m_columns = 0;
+	m_rows = 0;
+	m_built_count = obstacles.size();
+	m_indexed_count = 0;
+	m_outside_count = 0;
+
+	m_min = glm::dvec2{std::numeric_limits<double>::max()};
+	m_max = glm::dvec2{std::numeric_limits<double>::lowest()};
+	size_t bounded_count = 0;
+	for (auto &obstacle : obstacles)
+	{
+		if (auto bounds = padded_bounds(obstacle))
+		{
+			m_min = glm::min(m_min, bounds->first);
+			m_max = glm::max(m_max, bounds->second);
+			bounded_count++;
+		}
+	}
+
+	if (bounded_count > 0)
+	{
+		//roughly one cell per obstacle, shaped after the floor
+		auto extent = m_max - m_min;
+		auto cell_count = static_cast<double>(bounded_count);
+		m_columns = std::clamp(
+		    static_cast<int>(
+		        std::ceil(std::sqrt(cell_count * extent.x / extent.y))),
+		    1,
+		    max_cells_per_axis);
+		m_rows = std::clamp(
+		    static_cast<int>(std::ceil(cell_count / m_columns)),
+		    1,
+		    max_cells_per_axis);
+		m_cell_size = extent / glm::dvec2{double(m_columns), double(m_rows)};
+		m_cells.resize(static_cast<size_t>(m_columns) * m_rows);
+	}
+
+	for (auto iter = obstacles.begin(); iter != obstacles.end(); ++iter)
+	{
+		insert(iter.slot(), *iter);
+	}
+}
+
+void ObstacleGrid::insert(size_t id, const Obstacle &obstacle)
+{
+	if (id >= m_placements.size())
+	{
+		m_placements.resize(id + 1);
+	}
+	erase(id);
+	m_indexed_count++;
+
+	auto &placement = m_placements[id];
+	auto bounds = padded_bounds(obstacle);
+	if (!bounds || m_cells.empty() || bounds->first.x < m_min.x
+	    || bounds->first.y < m_min.y || bounds->second.x > m_max.x
+	    || bounds->second.y > m_max.y)
+	{
+		placement.kind = Placement::unbounded;
+		placement.outside = bounds.has_value();
+		m_outside_count += placement.outside;
+		m_unbounded.push_back(static_cast<uint32_t>(id));
+		return;
+	}
+
+	placement.kind = Placement::cells;
+	placement.min_column = column_of(bounds->first.x);
+	placement.max_column = column_of(bounds->second.x);
+	placement.min_row = row_of(bounds->first.y);
+	placement.max_row = row_of(bounds->second.y);
+	for (int row = placement.min_row; row <= placement.max_row; row++)
+	{
+		for (int column = placement.min_column; column <= placement.max_column;
+		     column++)
+		{
+			m_cells[static_cast<size_t>(row) * m_columns + column].push_back(
+			    static_cast<uint32_t>(id));
+		}
+	}
+}
+
+void ObstacleGrid::erase(size_t id)
+{
+	if (id >= m_placements.size())
+	{
+		return;
+	}
+	auto unordered_remove = [id](std::vector<uint32_t> &ids) {
+		auto found = std::find(ids.begin(), ids.end(), id);
+		*found = ids.back();
+		ids.pop_back();
+	};
+
+	auto &placement = m_placements[id];
+	switch (placement.kind)
+	{
+	case Placement::absent:
+		return;
+	case Placement::cells:
+		for (int row = placement.min_row; row <= placement.max_row; row++)
+		{
+			for (int column = placement.min_column;
+			     column <= placement.max_column;
+			     column++)
+			{
+				unordered_remove(
+				    m_cells[static_cast<size_t>(row) * m_columns + column]);
+			}
+		}
+		break;
+	case Placement::unbounded:
+		unordered_remove(m_unbounded);
+		m_outside_count -= placement.outside;
+		break;
+	}
+	m_indexed_count--;
+	placement = {};
+}
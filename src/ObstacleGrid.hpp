@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "ObstacleStore.hpp"
+
+//uniform grid over the rotated bounding boxes of a floor's obstacles
+//a segment query only visits the cells the segment actually passes through
+//obstacles are indexed by their ObstacleStore slot and can be added, moved
+//and removed one at a time
+class ObstacleGrid
+{
+	public:
+	//the cells are padded for expands up to this, bigger ones have to test
+	//every obstacle
+	static constexpr double max_expand = 0.02;
+
+	//sizes the grid after the obstacles and indexes all of them
+	void build(const ObstacleStore &obstacles);
+	//(re)indexes one obstacle, only touches the cells it covers
+	void insert(size_t id, const Obstacle &obstacle);
+	void erase(size_t id);
+	//true once enough obstacles were added or moved off the grid that a
+	//fresh build would pay off
+	bool needs_rebuild() const
+	{
+		return m_outside_count > 16 + m_built_count / 8
+		       || m_indexed_count > 16 + m_built_count * 2;
+	}
+
+	//calls callback(slot) once for every obstacle that could block the
+	//segment from -> to, if callback returns false the walk stops early and
+	//false is returned
+	template <typename Callback>
+	bool for_each_candidate(glm::dvec2 from, glm::dvec2 to, Callback &&callback)
+	    const;
+
+	//row major index of the cell containing point, clamped onto the grid
+	size_t cell_key(glm::dvec2 point) const
+	{
+		if (m_cells.empty() || !std::isfinite(point.x)
+		    || !std::isfinite(point.y))
+		{
+			return 0;
+		}
+		return static_cast<size_t>(row_of(point.y)) * m_columns
+		       + column_of(point.x);
+	}
+
+	private:
+	static std::pair<uint32_t *, uint32_t> begin_visit(size_t obstacle_count);
+
+	int column_of(double x) const
+	{
+		return std::clamp(
+		    static_cast<int>((x - m_min.x) / m_cell_size.x),
+		    0,
+		    m_columns - 1);
+	}
+	int row_of(double y) const
+	{
+		return std::clamp(
+		    static_cast<int>((y - m_min.y) / m_cell_size.y),
+		    0,
+		    m_rows - 1);
+	}
+
+	//where an obstacle was put, so it can be taken out again
+	struct Placement
+	{
+		enum
+		{
+			absent,
+			cells,
+			unbounded,
+		} kind = absent;
+		//in m_unbounded only because it reaches past the grid
+		bool outside = false;
+		int min_column = 0, min_row = 0, max_column = -1, max_row = -1;
+	};
+
+	glm::dvec2 m_min{0}, m_max{0}, m_cell_size{1};
+	int m_columns = 0, m_rows = 0;
+
+	//obstacle slots per cell, in no particular order
+	std::vector<std::vector<uint32_t>> m_cells;
+	//obstacles without a finite bounding box or reaching past the grid,
+	//these are always visited
+	std::vector<uint32_t> m_unbounded;
+	//by obstacle slot
+	std::vector<Placement> m_placements;
+	size_t m_built_count = 0, m_indexed_count = 0, m_outside_count = 0;
+};
+
+template <typename Callback>
+bool ObstacleGrid::for_each_candidate(
+    glm::dvec2 from,
+    glm::dvec2 to,
+    Callback &&callback) const
+{
+	for (auto id : m_unbounded)
+	{
+		if (!callback(id))
+		{
+			return false;
+		}
+	}
+	if (m_cells.empty())
+	{
+		return true;
+	}
+
+	if (!std::isfinite(from.x) || !std::isfinite(from.y)
+	    || !std::isfinite(to.x) || !std::isfinite(to.y))
+	{
+		for (size_t id = 0; id < m_placements.size(); id++)
+		{
+			if (m_placements[id].kind == Placement::cells && !callback(id))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//clip the segment to the grid bounds (Liang-Barsky)
+	auto delta = to - from;
+	double t_enter = 0, t_exit = 1;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (delta[axis] == 0)
+		{
+			if (from[axis] < m_min[axis] || from[axis] > m_max[axis])
+			{
+				return true;
+			}
+			continue;
+		}
+		double t_a = (m_min[axis] - from[axis]) / delta[axis];
+		double t_b = (m_max[axis] - from[axis]) / delta[axis];
+		if (t_a > t_b)
+		{
+			std::swap(t_a, t_b);
+		}
+		t_enter = std::max(t_enter, t_a);
+		t_exit = std::min(t_exit, t_b);
+		if (t_enter > t_exit)
+		{
+			return true;
+		}
+	}
+
+	auto entry = from + delta * t_enter;
+	auto exit = from + delta * t_exit;
+	int column = column_of(entry.x), row = row_of(entry.y);
+	int end_column = column_of(exit.x), end_row = row_of(exit.y);
+
+	//Amanatides & Woo style walk over the cells
+	constexpr double infinity = std::numeric_limits<double>::infinity();
+	int step_column = delta.x > 0 ? 1 : (delta.x < 0 ? -1 : 0);
+	int step_row = delta.y > 0 ? 1 : (delta.y < 0 ? -1 : 0);
+	double t_next_column
+	    = step_column == 0
+	          ? infinity
+	          : (m_min.x + (column + (step_column > 0)) * m_cell_size.x - from.x)
+	                / delta.x;
+	double t_next_row
+	    = step_row == 0
+	          ? infinity
+	          : (m_min.y + (row + (step_row > 0)) * m_cell_size.y - from.y)
+	                / delta.y;
+	double t_column_delta
+	    = step_column == 0 ? infinity : m_cell_size.x / std::abs(delta.x);
+	double t_row_delta
+	    = step_row == 0 ? infinity : m_cell_size.y / std::abs(delta.y);
+
+	auto [stamps, stamp] = begin_visit(m_placements.size());
+	while (true)
+	{
+		auto cell = static_cast<size_t>(row) * m_columns + column;
+		for (auto id : m_cells[cell])
+		{
+			if (stamps[id] != stamp)
+			{
+				stamps[id] = stamp;
+				if (!callback(id))
+				{
+					return false;
+				}
+			}
+		}
+
+		if ((column == end_column && row == end_row)
+		    || std::min(t_next_column, t_next_row) > t_exit)
+		{
+			break;
+		}
+		if (t_next_column < t_next_row)
+		{
+			column += step_column;
+			t_next_column += t_column_delta;
+		}
+		else
+		{
+			row += step_row;
+			t_next_row += t_row_delta;
+		}
+		if (column < 0 || column >= m_columns || row < 0 || row >= m_rows)
+		{
+			break;
+		}
+	}
+	return true;
+}
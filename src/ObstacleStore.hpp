@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+//the obstacles of one floor, an obstacle keeps its id until it is removed
+//an id is a slot in the low 32 bits and the generation of that slot in the
+//high ones, a removal bumps the generation and frees the slot for the next
+//insert, so an id kept past a removal finds nothing rather than whatever
+//took its slot, while the dense per slot tables stay as large as the most
+//obstacles the floor held at once
+//iteration visits the live obstacles in slot order
+template <typename T>
+class SlotStore
+{
+	template <typename Store, typename Value>
+	class Iterator
+	{
+		public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = Value *;
+		using reference = Value &;
+
+		Iterator() = default;
+		Iterator(Store *store, size_t slot) : m_store(store), m_slot(slot)
+		{
+			skip_removed();
+		}
+
+		size_t id() const { return m_store->id_of(m_slot); }
+		size_t slot() const { return m_slot; }
+		reference operator*() const { return *m_store->m_slots[m_slot]; }
+		pointer operator->() const { return &*m_store->m_slots[m_slot]; }
+		Iterator &operator++()
+		{
+			m_slot++;
+			skip_removed();
+			return *this;
+		}
+		Iterator operator++(int)
+		{
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+		bool operator==(const Iterator &other) const
+		{
+			return m_slot == other.m_slot;
+		}
+
+		private:
+		void skip_removed()
+		{
+			while (m_slot < m_store->m_slots.size()
+			       && !m_store->m_slots[m_slot])
+			{
+				m_slot++;
+			}
+		}
+
+		Store *m_store = nullptr;
+		size_t m_slot = 0;
+	};
+
+	public:
+	using iterator = Iterator<SlotStore, T>;
+	using const_iterator = Iterator<const SlotStore, const T>;
+
+	SlotStore() = default;
+	SlotStore(const std::vector<T> &values)
+	{
+		for (auto &value : values)
+		{
+			insert(value);
+		}
+	}
+
+	static size_t slot_of(size_t id) { return id & UINT32_MAX; }
+	//the id of the value in slot, only meaningful while it is occupied
+	size_t id_of(size_t slot) const
+	{
+		return slot | static_cast<size_t>(m_generations[slot]) << 32;
+	}
+
+	size_t insert(T value)
+	{
+		m_size++;
+		if (m_free.empty())
+		{
+			m_slots.emplace_back(std::move(value));
+			m_generations.push_back(0);
+			return m_slots.size() - 1;
+		}
+		auto slot = m_free.back();
+		m_free.pop_back();
+		m_slots[slot].emplace(std::move(value));
+		return id_of(slot);
+	}
+	void erase(size_t id)
+	{
+		if (!contains(id))
+		{
+			throw std::out_of_range{"SlotStore::erase"};
+		}
+		auto slot = slot_of(id);
+		m_slots[slot].reset();
+		m_size--;
+		//a slot whose generation would wrap is never used again
+		if (m_generations[slot] < UINT32_MAX)
+		{
+			m_generations[slot]++;
+			m_free.push_back(slot);
+		}
+	}
+	bool contains(size_t id) const
+	{
+		auto slot = slot_of(id);
+		return occupied(slot) && id >> 32 == m_generations[slot];
+	}
+	bool occupied(size_t slot) const
+	{
+		return slot < m_slots.size() && m_slots[slot].has_value();
+	}
+
+	T &at(size_t id)
+	{
+		if (!contains(id))
+		{
+			throw std::out_of_range{"SlotStore::at"};
+		}
+		return *m_slots[slot_of(id)];
+	}
+	const T &at(size_t id) const
+	{
+		if (!contains(id))
+		{
+			throw std::out_of_range{"SlotStore::at"};
+		}
+		return *m_slots[slot_of(id)];
+	}
+	//unchecked, takes an id or a bare slot
+	T &operator[](size_t id) { return *m_slots[slot_of(id)]; }
+	const T &operator[](size_t id) const { return *m_slots[slot_of(id)]; }
+
+	//number of live values
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	//every slot is below this
+	size_t slot_limit() const { return m_slots.size(); }
+
+	iterator begin() { return {this, 0}; }
+	iterator end() { return {this, m_slots.size()}; }
+	const_iterator begin() const { return {this, 0}; }
+	const_iterator end() const { return {this, m_slots.size()}; }
+
+	private:
+	std::vector<std::optional<T>> m_slots;
+	std::vector<uint32_t> m_generations;
+	std::vector<size_t> m_free;
+	size_t m_size = 0;
+};
+
+struct Obstacle;
+using ObstacleStore = SlotStore<Obstacle>;
@@ -0,0 +1,230 @@
+#include "PathCache.hpp"
+
+#include "Hash.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <tuple>
+
+PathCache::PathCache(const PathCache &other) { *this = other; }
+
+PathCache &PathCache::operator=(const PathCache &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	Settings settings;
+	Stats stats;
+	{
+		std::lock_guard lock{other.m_mutex};
+		settings = other.m_settings;
+		stats = other.m_stats;
+	}
+	stats.entries = 0;
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_index.clear();
+	m_settings = settings;
+	m_stats = stats;
+	m_enabled = settings.enabled;
+	m_max_detour = settings.max_detour;
+	return *this;
+}
+
+void PathCache::configure(Settings settings)
+{
+	std::lock_guard lock{m_mutex};
+	if (!settings.enabled)
+	{
+		m_entries.clear();
+		m_index.clear();
+	}
+	m_settings = settings;
+	evict_to(settings.capacity);
+	m_enabled = settings.enabled && settings.capacity > 0;
+	m_max_detour = settings.max_detour;
+}
+
+PathCache::Settings PathCache::settings() const
+{
+	std::lock_guard lock{m_mutex};
+	return m_settings;
+}
+
+std::shared_ptr<const PathResult> PathCache::find(
+    const Key &key,
+    uint64_t changers,
+    const FloorVersion &floor_version)
+{
+	if (!enabled())
+	{
+		return nullptr;
+	}
+	std::lock_guard lock{m_mutex};
+	auto found = m_index.find(key);
+	if (found == m_index.end())
+	{
+		m_stats.misses++;
+		return nullptr;
+	}
+	auto &origin = found->second->origin;
+	bool current = origin.changers == changers;
+	for (auto [floor, version] : origin.floor_versions)
+	{
+		current = current && floor_version(floor) == version;
+	}
+	if (!current)
+	{
+		m_entries.erase(found->second);
+		m_index.erase(found);
+		m_stats.invalidations++;
+		m_stats.misses++;
+		return nullptr;
+	}
+	m_stats.hits++;
+	if (m_held)
+	{
+		m_held_hits.push_back(key);
+	}
+	else
+	{
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+	}
+	return found->second->path;
+}
+
+void PathCache::insert(
+    const Key &key,
+    std::shared_ptr<const PathResult> path,
+    Origin origin)
+{
+	if (!enabled())
+	{
+		return;
+	}
+	std::lock_guard lock{m_mutex};
+	if (m_held)
+	{
+		m_held_inserts.push_back({key, std::move(path), std::move(origin)});
+		return;
+	}
+	store({key, std::move(path), std::move(origin)});
+}
+
+void PathCache::count_unsnapped()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats.unsnapped++;
+}
+
+void PathCache::count_too_long()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats.too_long++;
+}
+
+void PathCache::clear()
+{
+	std::lock_guard lock{m_mutex};
+	m_entries.clear();
+	m_index.clear();
+	m_held_inserts.clear();
+}
+
+void PathCache::hold(bool held)
+{
+	std::lock_guard lock{m_mutex};
+	m_held = held;
+	if (held)
+	{
+		return;
+	}
+	auto fields = [](const Key &key) {
+		return std::tuple{
+		    key.from_floor,
+		    key.from.x,
+		    key.from.y,
+		    key.to_floor,
+		    key.to.x,
+		    key.to.y};
+	};
+	auto before = [&](const Key &a, const Key &b) {
+		return fields(a) < fields(b);
+	};
+	std::ranges::sort(m_held_hits, before);
+	for (auto &key : m_held_hits)
+	{
+		if (auto found = m_index.find(key); found != m_index.end())
+		{
+			m_entries.splice(m_entries.begin(), m_entries, found->second);
+		}
+	}
+	//queries that snapped to the same vertecies found the same path, the
+	//first one is kept
+	std::ranges::stable_sort(m_held_inserts, before, &Entry::key);
+	for (size_t i = 0; i < m_held_inserts.size(); i++)
+	{
+		if (i == 0 || !(m_held_inserts[i].key == m_held_inserts[i - 1].key))
+		{
+			store(std::move(m_held_inserts[i]));
+		}
+	}
+	m_held_hits.clear();
+	m_held_inserts.clear();
+}
+
+PathCache::Stats PathCache::stats() const
+{
+	std::lock_guard lock{m_mutex};
+	auto stats = m_stats;
+	stats.entries = m_entries.size();
+	return stats;
+}
+
+void PathCache::reset_stats()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats = {};
+}
+
+size_t PathCache::KeyHash::operator()(const Key &key) const
+{
+	uint64_t hash = mix64(
+	    static_cast<uint32_t>(key.from_floor)
+	    | static_cast<uint64_t>(static_cast<uint32_t>(key.to_floor)) << 32);
+	for (auto value : {key.from.x, key.from.y, key.to.x, key.to.y})
+	{
+		hash = mix64(hash ^ std::bit_cast<uint64_t>(value));
+	}
+	return hash;
+}
+
+void PathCache::store(Entry entry)
+{
+	if (m_settings.capacity == 0)
+	{
+		return;
+	}
+	if (auto found = m_index.find(entry.key); found != m_index.end())
+	{
+		found->second->path = std::move(entry.path);
+		found->second->origin = std::move(entry.origin);
+		m_entries.splice(m_entries.begin(), m_entries, found->second);
+		return;
+	}
+	evict_to(m_settings.capacity - 1);
+	auto key = entry.key;
+	m_entries.push_front(std::move(entry));
+	m_index.emplace(key, m_entries.begin());
+}
+
+void PathCache::evict_to(size_t capacity)
+{
+	while (m_entries.size() > capacity)
+	{
+		m_index.erase(m_entries.back().key);
+		m_entries.pop_back();
+		m_stats.evictions++;
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "PathResult.hpp"
+
+//remembers the paths World::calculate_path found between two graph
+//vertecies, for people whose routines send them on the same trips every
+//repeat_interval
+//a query is snapped to the vertex nearest to its start and the one nearest
+//to its target, the path between those is shared between everyone asking,
+//nobody may change it, and the real start and target join it where they
+//see it, see World::cached_path
+//an entry is dropped on the next lookup once a floor its path crosses was
+//edited or the floor changers changed
+class PathCache
+{
+	public:
+	struct Settings
+	{
+		bool enabled = false;
+		size_t capacity = 4096;
+		//a path is only handed out if it is at most this many times as
+		//long as the shortest one, going by a lower bound of that, the
+		//default only lets through paths as short as planning them gives,
+		//anything above 1 trades length for hits
+		double max_detour = 1 + 1e-9;
+	};
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		//entries dropped because their floors changed
+		uint64_t invalidations = 0;
+		uint64_t evictions = 0;
+		//queries that went around the cache, with no vertex in sight of
+		//their start or target
+		uint64_t unsnapped = 0;
+		//queries whose path could be longer than max_detour allows, these
+		//are planned again from their own start and target
+		uint64_t too_long = 0;
+		size_t entries = 0;
+	};
+	//the snapped start and target
+	struct Key
+	{
+		int from_floor;
+		glm::dvec2 from;
+		int to_floor;
+		glm::dvec2 to;
+		bool operator==(const Key &) const = default;
+	};
+	//what a path was found on, the Floor::version of every floor it
+	//crosses and a hash of the floor changers
+	struct Origin
+	{
+		std::vector<std::pair<int, uint64_t>> floor_versions;
+		uint64_t changers = 0;
+	};
+	//the current version of a floor, none if it is gone
+	using FloorVersion = std::function<std::optional<uint64_t>(int)>;
+
+	PathCache() = default;
+	//copies only the settings and counters, never the entries
+	PathCache(const PathCache &other);
+	PathCache &operator=(const PathCache &other);
+
+	void configure(Settings settings);
+	Settings settings() const;
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	double max_detour() const
+	{
+		return m_max_detour.load(std::memory_order_relaxed);
+	}
+
+	//counts a hit or a miss, an entry found on floors or changers that have
+	//changed since is dropped and counts as a miss
+	std::shared_ptr<const PathResult> find(
+	    const Key &key,
+	    uint64_t changers,
+	    const FloorVersion &floor_version);
+	void insert(
+	    const Key &key,
+	    std::shared_ptr<const PathResult> path,
+	    Origin origin);
+	void count_unsnapped();
+	void count_too_long();
+	void clear();
+	//while held hits leave the order of the entries alone and inserts wait
+	//until the hold ends, then both are applied in the order of their keys,
+	//so queries running side by side in any order leave the same cache
+	//behind, see World::calculate_paths
+	void hold(bool held);
+
+	Stats stats() const;
+	void reset_stats();
+
+	private:
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+	struct Entry
+	{
+		Key key;
+		std::shared_ptr<const PathResult> path;
+		Origin origin;
+	};
+
+	//insert with the lock held
+	void store(Entry entry);
+	void evict_to(size_t capacity);
+
+	mutable std::mutex m_mutex;
+	std::atomic<bool> m_enabled{false};
+	std::atomic<double> m_max_detour{Settings{}.max_detour};
+	Settings m_settings;
+	//most recently used at the front
+	std::list<Entry> m_entries;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+	Stats m_stats;
+	bool m_held = false;
+	std::vector<Key> m_held_hits;
+	std::vector<Entry> m_held_inserts;
+};
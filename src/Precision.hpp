@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glm/ext.hpp>
+
+//scalar type of the simulation hot paths, movement, infection and their line
+//of sight tests, the editor, obstacles and save files always use doubles
+#ifdef CORONA_SIM_SINGLE_PRECISION
+using sim_scalar = float;
+#else
+using sim_scalar = double;
+#endif
+
+template <typename T>
+using vec2_of = glm::vec<2, T>;
+using sim_vec2 = vec2_of<sim_scalar>;
@@ -0,0 +1,42 @@
+#include "Raster.hpp"
+
+#include "world.hpp"
+
+bool Raster::fit(
+    const ObstacleStore &obstacles,
+    bool Obstacle::*blocks,
+    int cells_per_axis)
+{
+	columns = 0;
+	rows = 0;
+
+	//people mostly live on the unit square, so it is always covered
+	glm::dvec2 low{0}, high{1};
+	for (auto &obstacle : obstacles)
+	{
+		if (!(obstacle.*blocks))
+		{
+			continue;
+		}
+		for (auto &corner : obstacle.geometry().vertecies[0])
+		{
+			if (!std::isfinite(corner.x) || !std::isfinite(corner.y))
+			{
+				return false;
+			}
+			low = glm::min(low, corner);
+			high = glm::max(high, corner);
+		}
+	}
+
+	auto extent = high - low;
+	cell_size = std::max(extent.x, extent.y) / (cells_per_axis - 2);
+	min = low - glm::dvec2{cell_size};
+	columns = std::min(
+	    cells_per_axis,
+	    static_cast<int>(std::ceil(extent.x / cell_size)) + 2);
+	rows = std::min(
+	    cells_per_axis,
+	    static_cast<int>(std::ceil(extent.y / cell_size)) + 2);
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <optional>
+
+#include <glm/ext.hpp>
+
+#include "LineIntersect.hpp"
+#include "ObstacleStore.hpp"
+
+//the square cells RoomMap lays over a floor, covering the unit square and
+//the outlines of the obstacles it looks at, with one free cell of padding
+//all around so nothing reaches past the grid
+struct Raster
+{
+	//cells are grown by this before being compared with the obstacles
+	static constexpr double margin = intersect_margin;
+
+	glm::dvec2 min{0};
+	double cell_size = 1;
+	int columns = 0, rows = 0;
+
+	//sizes the grid after the obstacles with the flag blocks set, at most
+	//cells_per_axis along either side, false if an outline has a corner
+	//that isn't finite, the grid is empty then
+	bool fit(
+	    const ObstacleStore &obstacles,
+	    bool Obstacle::*blocks,
+	    int cells_per_axis);
+
+	size_t cell_count() const { return static_cast<size_t>(columns) * rows; }
+	glm::dvec2 cell_min(int column, int row) const
+	{
+		return min + glm::dvec2{column, row} * cell_size;
+	}
+	glm::dvec2 max() const { return cell_min(columns, rows); }
+	//the row major index of the cell containing point, none outside
+	std::optional<size_t> cell_of(glm::dvec2 point) const
+	{
+		auto cell = glm::floor((point - min) / cell_size);
+		//also false for nan
+		if (!(cell.x >= 0 && cell.y >= 0 && cell.x < columns && cell.y < rows))
+		{
+			return std::nullopt;
+		}
+		return static_cast<size_t>(cell.y) * columns
+		       + static_cast<size_t>(cell.x);
+	}
+
+	//calls visit(cell, low, high) for every cell within margin of the
+	//bounding box of corners, low and high being the corners of the cell
+	//grown by margin
+	template <typename Visit>
+	void for_each_cell(
+	    const std::array<glm::dvec2, 4> &corners,
+	    Visit &&visit) const
+	{
+		glm::dvec2 corner_min = corners[0], corner_max = corners[0];
+		for (auto &corner : corners)
+		{
+			corner_min = glm::min(corner_min, corner);
+			corner_max = glm::max(corner_max, corner);
+		}
+		auto first = glm::floor((corner_min - margin - min) / cell_size);
+		auto last = glm::floor((corner_max + margin - min) / cell_size);
+		for (int row = std::max(0, static_cast<int>(first.y));
+		     row <= std::min(rows - 1, static_cast<int>(last.y));
+		     row++)
+		{
+			for (int column = std::max(0, static_cast<int>(first.x));
+			     column <= std::min(columns - 1, static_cast<int>(last.x));
+			     column++)
+			{
+				visit(
+				    static_cast<size_t>(row) * columns + column,
+				    cell_min(column, row) - margin,
+				    cell_min(column + 1, row + 1) + margin);
+			}
+		}
+	}
+};
@@ -139,9 +139,8 @@ void Renderer::Draw(const SimManager &manager, glm::dvec2 mouse)
 		auto floor = std::get<0>(manager.viewing_floor_or_group);
 		if (map.contains(floor))
 		{
-			for (size_t i = 0; i < map.at(floor).obstacles.size(); i++)
+			for (auto &obstacle : map.at(floor).obstacles)
 			{
-				auto &obstacle = map.at(floor).obstacles[i];
 				draw_rectangle(
 				    obstacle.position,
 				    obstacle.size,
@@ -0,0 +1,166 @@
+#include "RoomMap.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "world.hpp"
+
+namespace
+{
+//true if the whole box lies inside the obstacle
+bool covers(const Obstacle &obstacle, glm::dvec2 min, glm::dvec2 max)
+{
+	auto &inverse_rotation = obstacle.geometry().inverse_rotation;
+	auto obstacle_max = obstacle.position + obstacle.size;
+	for (auto corner :
+	     {min, glm::dvec2{max.x, min.y}, max, glm::dvec2{min.x, max.y}})
+	{
+		auto local = inverse_rotation * glm::dvec4{corner, 0, 1};
+		if (!(local.x >= obstacle.position.x && local.y >= obstacle.position.y
+		      && local.x <= obstacle_max.x && local.y <= obstacle_max.y))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+} // namespace
+
+void RoomMap::build(const ObstacleStore &obstacles)
+{
+	m_convex.clear();
+	m_component.clear();
+	if (!m_raster.fit(obstacles, &Obstacle::blocks_infection, cells_per_axis))
+	{
+		//nothing can be decided, every lookup returns none
+		return;
+	}
+	auto cell_count = m_raster.cell_count();
+	auto columns = m_raster.columns, rows = m_raster.rows;
+
+	//touched cells come near an obstacle, covered ones are entirely inside
+	//of one
+	std::vector<bool> touched(cell_count, false), covered(cell_count, false);
+	for (auto &obstacle : obstacles)
+	{
+		if (!obstacle.blocks_infection)
+		{
+			continue;
+		}
+		auto &geometry = obstacle.geometry();
+		m_raster.for_each_cell(
+		    geometry.vertecies[0],
+		    [&](size_t cell, glm::dvec2 low, glm::dvec2 high) {
+			    if (!touched[cell] && geometry.overlaps(low, high))
+			    {
+				    touched[cell] = true;
+			    }
+			    //an obstacle without area is only its outline, a segment
+			    //can end inside of it without being blocked
+			    if (!covered[cell] && geometry.has_positive_size
+			        && covers(obstacle, low, high))
+			    {
+				    covered[cell] = true;
+			    }
+		    });
+	}
+
+	//greedy maximal rectangles of untouched cells
+	m_convex.assign(cell_count, RoomId::none);
+	uint32_t next_convex = 0;
+	auto is_open = [&](int column, int row) {
+		auto cell = static_cast<size_t>(row) * columns + column;
+		return !touched[cell] && m_convex[cell] == RoomId::none;
+	};
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			if (!is_open(column, row))
+			{
+				continue;
+			}
+			int end_column = column;
+			while (end_column + 1 < columns && is_open(end_column + 1, row))
+			{
+				end_column++;
+			}
+			int end_row = row;
+			while (end_row + 1 < rows)
+			{
+				bool row_open = true;
+				for (int x = column; x <= end_column && row_open; x++)
+				{
+					row_open = is_open(x, end_row + 1);
+				}
+				if (!row_open)
+				{
+					break;
+				}
+				end_row++;
+			}
+			for (int y = row; y <= end_row; y++)
+			{
+				std::fill(
+				    m_convex.begin() + static_cast<size_t>(y) * columns + column,
+				    m_convex.begin() + static_cast<size_t>(y) * columns
+				        + end_column + 1,
+				    next_convex);
+			}
+			next_convex++;
+		}
+	}
+
+	//8 connected flood fill of the cells that are not covered, a segment
+	//can slip between two diagonal neighbours
+	m_component.assign(cell_count, RoomId::none);
+	uint32_t next_component = 0;
+	std::vector<size_t> stack;
+	for (size_t start = 0; start < cell_count; start++)
+	{
+		if (covered[start] || m_component[start] != RoomId::none)
+		{
+			continue;
+		}
+		m_component[start] = next_component;
+		stack.push_back(start);
+		while (!stack.empty())
+		{
+			auto cell = stack.back();
+			stack.pop_back();
+			int column = static_cast<int>(cell % columns);
+			int row = static_cast<int>(cell / columns);
+			for (int y = std::max(0, row - 1); y <= std::min(rows - 1, row + 1);
+			     y++)
+			{
+				for (int x = std::max(0, column - 1);
+				     x <= std::min(columns - 1, column + 1);
+				     x++)
+				{
+					auto neighbour = static_cast<size_t>(y) * columns + x;
+					if (!covered[neighbour]
+					    && m_component[neighbour] == RoomId::none)
+					{
+						m_component[neighbour] = next_component;
+						stack.push_back(neighbour);
+					}
+				}
+			}
+		}
+		next_component++;
+	}
+}
+
+RoomId RoomMap::locate(glm::dvec2 point) const
+{
+	if (m_convex.empty())
+	{
+		return {};
+	}
+	auto cell = m_raster.cell_of(point);
+	if (!cell)
+	{
+		return {};
+	}
+	return {m_convex[*cell], m_component[*cell]};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "ObstacleStore.hpp"
+#include "Raster.hpp"
+
+//where a point is according to a floor's RoomMap
+struct RoomId
+{
+	static constexpr uint32_t none = std::numeric_limits<uint32_t>::max();
+	//obstacle free rectangle containing the point
+	uint32_t convex = none;
+	//connected part of the floor containing the point
+	uint32_t component = none;
+};
+
+//splits a floor into rectangles no blocks_infection obstacle touches and into
+//regions that are walled off from each other by them
+//both are conservative: a point near an obstacle gets no rectangle and a
+//gap between walls joins two regions, so whatever the map decides is exactly
+//what the infection line of sight test would have said
+class RoomMap
+{
+	public:
+	//cells along the longer side of the floor
+	static constexpr int cells_per_axis = 512;
+
+	void build(const ObstacleStore &obstacles);
+	RoomId locate(glm::dvec2 point) const;
+
+	//the infection line of sight between points in rooms a and b, if the
+	//rooms alone decide it
+	static std::optional<bool> infection_line_of_sight(RoomId a, RoomId b)
+	{
+		if (a.convex != RoomId::none && a.convex == b.convex)
+		{
+			return true;
+		}
+		if (a.component != RoomId::none && b.component != RoomId::none
+		    && a.component != b.component)
+		{
+			return false;
+		}
+		return std::nullopt;
+	}
+
+	private:
+	Raster m_raster;
+
+	//per cell, row major
+	std::vector<uint32_t> m_convex;
+	std::vector<uint32_t> m_component;
+};
@@ -0,0 +1,283 @@
+#include "RouteTable.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "ThreadPool.hpp"
+
+RouteTable::RouteTable(std::shared_ptr<const VisibilityGraph> graph)
+    : m_graph(std::move(graph))
+{
+	auto vertex_count = size();
+	m_distance.assign(
+	    vertex_count * vertex_count,
+	    std::numeric_limits<double>::infinity());
+	m_next.assign(vertex_count * vertex_count, none);
+
+	//every row is a Dijkstra of its own, the graph's edges go both ways
+	ThreadPool::shared().parallel_for(vertex_count, [&](size_t to) {
+		auto distance = &m_distance[to * vertex_count];
+		auto next = &m_next[to * vertex_count];
+		using Candidate = std::pair<double, uint32_t>;
+		thread_local std::vector<Candidate> open;
+		open.clear();
+		distance[to] = 0;
+		open.emplace_back(0, static_cast<uint32_t>(to));
+		while (!open.empty())
+		{
+			std::pop_heap(open.begin(), open.end(), std::greater<>{});
+			auto [length, i] = open.back();
+			open.pop_back();
+			if (length > distance[i])
+			{
+				continue;
+			}
+			auto neighbours = m_graph->neighbours(i);
+			auto lengths = m_graph->lengths(i);
+			for (size_t k = 0; k < neighbours.size(); k++)
+			{
+				auto through = length + lengths[k];
+				if (through < distance[neighbours[k]])
+				{
+					distance[neighbours[k]] = through;
+					next[neighbours[k]] = i;
+					open.emplace_back(through, neighbours[k]);
+					std::push_heap(open.begin(), open.end(), std::greater<>{});
+				}
+			}
+		}
+	});
+}
+
+std::optional<size_t> RouteTable::find_path(
+    glm::dvec2 start,
+    std::span<const glm::dvec2> ends,
+    const Visibility &visibility,
+    std::vector<glm::dvec2> &path) const
+{
+	//the links of this many vertecies are tested at a time
+	constexpr size_t chunk_size = 32;
+
+	path.clear();
+	auto vertex_count = size();
+	auto stride = 1 + ends.size();
+	thread_local std::vector<LineSegment> segments;
+	thread_local std::unique_ptr<bool[]> visible;
+	thread_local size_t visible_size = 0;
+	auto test = [&] {
+		if (visible_size < segments.size())
+		{
+			visible = std::make_unique<bool[]>(segments.size());
+			visible_size = segments.size();
+		}
+		std::span<bool> out{visible.get(), segments.size()};
+		visibility(segments, out);
+		return std::span<const bool>{out};
+	};
+
+	auto best = std::numeric_limits<double>::infinity();
+	auto best_end = none, first = none, last = none;
+	//a straight line can't be beaten
+	segments.clear();
+	for (auto end : ends)
+	{
+		segments.push_back({end, start});
+	}
+	auto sees_start = test();
+	for (size_t end = 0; end < ends.size(); end++)
+	{
+		auto distance = glm::distance(start, ends[end]);
+		if (sees_start[end] && distance < best)
+		{
+			best = distance;
+			best_end = static_cast<uint32_t>(end);
+		}
+	}
+
+	//every vertex with the shortest a way through it can be
+	thread_local std::vector<std::pair<double, uint32_t>> order;
+	order.clear();
+	for (uint32_t i = 0; i < vertex_count; i++)
+	{
+		auto position = m_graph->position(i);
+		auto to_end = std::numeric_limits<double>::infinity();
+		for (auto end : ends)
+		{
+			to_end = std::min(to_end, glm::distance(position, end));
+		}
+		order.emplace_back(glm::distance(start, position) + to_end, i);
+	}
+	std::sort(order.begin(), order.end());
+
+	//the vertecies found to see the start and the ones found to see an end,
+	//each with the length of the link, every pair of them is a way
+	thread_local std::vector<std::pair<uint32_t, double>> start_links;
+	struct EndLink
+	{
+		uint32_t vertex, end;
+		double length;
+	};
+	thread_local std::vector<EndLink> end_links;
+	start_links.clear();
+	end_links.clear();
+	auto consider = [&](uint32_t from, double start_length, const EndLink &to) {
+		auto row = &m_distance[to.vertex * vertex_count];
+		auto distance = start_length + row[from] + to.length;
+		if (distance < best)
+		{
+			best = distance;
+			best_end = to.end;
+			first = from;
+			last = to.vertex;
+		}
+	};
+	for (size_t next = 0; next < order.size() && order[next].first < best;
+	     next += chunk_size)
+	{
+		auto chunk = std::span{order}.subspan(
+		    next,
+		    std::min(chunk_size, order.size() - next));
+		segments.clear();
+		for (auto [at_least, i] : chunk)
+		{
+			segments.push_back({start, m_graph->position(i)});
+			for (auto end : ends)
+			{
+				segments.push_back({end, m_graph->position(i)});
+			}
+		}
+		auto seen = test();
+		for (size_t k = 0; k < chunk.size(); k++)
+		{
+			auto i = chunk[k].second;
+			auto position = m_graph->position(i);
+			auto links = seen.subspan(k * stride, stride);
+			if (links[0])
+			{
+				auto length = glm::distance(start, position);
+				start_links.emplace_back(i, length);
+				for (auto &link : end_links)
+				{
+					consider(i, length, link);
+				}
+			}
+			for (size_t end = 0; end < ends.size(); end++)
+			{
+				if (!links[1 + end])
+				{
+					continue;
+				}
+				auto &link = end_links.emplace_back(
+				    i,
+				    static_cast<uint32_t>(end),
+				    glm::distance(position, ends[end]));
+				for (auto [from, length] : start_links)
+				{
+					consider(from, length, link);
+				}
+			}
+		}
+	}
+	if (best_end == none)
+	{
+		return std::nullopt;
+	}
+
+	path.push_back(start);
+	if (first != none)
+	{
+		auto next = &m_next[last * vertex_count];
+		for (auto at = first; at != none; at = next[at])
+		{
+			path.push_back(m_graph->position(at));
+		}
+	}
+	path.push_back(ends[best_end]);
+	return best_end;
+}
+
+size_t RouteTable::memory_bytes() const
+{
+	return m_distance.capacity() * sizeof(double)
+	       + m_next.capacity() * sizeof(uint32_t);
+}
+
+RouteTableCache::RouteTableCache(const RouteTableCache &other)
+{
+	*this = other;
+}
+
+RouteTableCache &RouteTableCache::operator=(const RouteTableCache &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	Settings settings;
+	Stats stats;
+	{
+		std::lock_guard lock{other.m_mutex};
+		settings = other.m_settings;
+		stats = other.m_stats;
+	}
+	std::lock_guard lock{m_mutex};
+	m_table = nullptr;
+	m_settings = settings;
+	m_stats = stats;
+	return *this;
+}
+
+void RouteTableCache::configure(Settings settings)
+{
+	std::lock_guard lock{m_mutex};
+	if (!settings.enabled
+	    || (m_table && m_table->size() > settings.max_vertecies))
+	{
+		m_table = nullptr;
+	}
+	m_settings = settings;
+}
+
+RouteTableCache::Settings RouteTableCache::settings() const
+{
+	std::lock_guard lock{m_mutex};
+	return m_settings;
+}
+
+std::shared_ptr<const RouteTable>
+RouteTableCache::find(const std::shared_ptr<const VisibilityGraph> &graph)
+{
+	std::lock_guard lock{m_mutex};
+	if (!m_settings.enabled || graph->size() == 0
+	    || graph->size() > m_settings.max_vertecies)
+	{
+		return nullptr;
+	}
+	if (!m_table || m_table->graph() != graph)
+	{
+		//built under the lock, a query waiting for it would otherwise
+		//build the same table again
+		m_table = std::make_shared<RouteTable>(graph);
+		m_stats.builds++;
+	}
+	m_stats.queries++;
+	return m_table;
+}
+
+RouteTableCache::Stats RouteTableCache::stats() const
+{
+	std::lock_guard lock{m_mutex};
+	auto stats = m_stats;
+	if (m_table)
+	{
+		stats.vertecies = m_table->size();
+		stats.bytes = m_table->memory_bytes();
+	}
+	return stats;
+}
+
+void RouteTableCache::reset_stats()
+{
+	std::lock_guard lock{m_mutex};
+	m_stats = {};
+}
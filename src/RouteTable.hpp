@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+#include "LineOfSight.hpp"
+#include "VisibilityGraph.hpp"
+
+//the shortest way between every two vertecies of a small visibility graph,
+//the length and the next vertex on it, one Dijkstra per vertex
+//a path query only has to link the start and the ends to the vertecies
+//they see and take the shortest combination, there is no search left
+//a way through a vertex is at least as long as the straight line from the
+//start to it and on to an end, so the links are tested nearest by that
+//first and only until no vertex left could make the way shorter
+//it takes 12 bytes per pair of vertecies, so it is meant for fixed floors
+//of a few hundred vertecies that are queried again and again
+class RouteTable
+{
+	public:
+	//fills out[i] with whether segments[i] is unobstructed, like AStar's
+	using Visibility
+	    = std::function<void(std::span<const LineSegment>, std::span<bool>)>;
+
+	explicit RouteTable(std::shared_ptr<const VisibilityGraph> graph);
+
+	//the shortest way from start to the nearest of ends into path, start
+	//first and the end reached last like AStar::path_result, and the
+	//index of the end, as short as the one AStar finds
+	std::optional<size_t> find_path(
+	    glm::dvec2 start,
+	    std::span<const glm::dvec2> ends,
+	    const Visibility &visibility,
+	    std::vector<glm::dvec2> &path) const;
+
+	//the length of the shortest way between two vertecies, infinite if
+	//there is none
+	double distance(size_t from, size_t to) const
+	{
+		return m_distance[to * size() + from];
+	}
+	size_t size() const { return m_graph->size(); }
+	//the graph it was built on
+	const std::shared_ptr<const VisibilityGraph> &graph() const
+	{
+		return m_graph;
+	}
+	//bytes allocated for the tables
+	size_t memory_bytes() const;
+
+	private:
+	static constexpr uint32_t none = UINT32_MAX;
+
+	std::shared_ptr<const VisibilityGraph> m_graph;
+	//row to holds the distance of every vertex to vertex to and the
+	//vertex after it on the way there, the Dijkstra tree rooted at to, so
+	//following the next vertecies never goes in circles
+	std::vector<double> m_distance;
+	std::vector<uint32_t> m_next;
+};
+
+//the route table of one floor, for its latest visibility graph
+class RouteTableCache
+{
+	public:
+	struct Settings
+	{
+		bool enabled = false;
+		//graphs with more vertecies go without a table
+		size_t max_vertecies = 1024;
+	};
+	struct Stats
+	{
+		uint64_t builds = 0;
+		//path queries answered from the table
+		uint64_t queries = 0;
+		size_t vertecies = 0;
+		size_t bytes = 0;
+
+		Stats &operator+=(const Stats &other)
+		{
+			builds += other.builds;
+			queries += other.queries;
+			vertecies += other.vertecies;
+			bytes += other.bytes;
+			return *this;
+		}
+	};
+
+	RouteTableCache() = default;
+	//copies only the settings and counters, never the table
+	RouteTableCache(const RouteTableCache &other);
+	RouteTableCache &operator=(const RouteTableCache &other);
+
+	void configure(Settings settings);
+	Settings settings() const;
+
+	//counts a query and returns the table for graph, built first if the
+	//one kept is for another graph, nullptr while tables are off or graph
+	//is too large
+	std::shared_ptr<const RouteTable>
+	find(const std::shared_ptr<const VisibilityGraph> &graph);
+
+	Stats stats() const;
+	void reset_stats();
+
+	private:
+	mutable std::mutex m_mutex;
+	Settings m_settings;
+	std::shared_ptr<const RouteTable> m_table;
+	Stats m_stats;
+};
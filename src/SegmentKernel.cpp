@@ -0,0 +1,513 @@
+#include "SegmentKernel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CORONA_SIM_HAS_AVX2_KERNEL
+#endif
+
+#include "world.hpp"
+
+namespace
+{
+template <typename T>
+bool scalar_intersects(
+    const BasicPackedObstacle<T> &obstacle,
+    vec2_of<T> from,
+    vec2_of<T> to,
+    size_t expand_level)
+{
+	auto expand = static_cast<T>(ObstacleGeometry::cached_expands[expand_level]);
+	auto margin = static_cast<T>(intersect_margin);
+	if (obstacle.has_positive_size)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			auto limit = obstacle.normal_offset[i] + expand + margin;
+			auto from_dot
+			    = obstacle.normal_x[i] * from.x + obstacle.normal_y[i] * from.y;
+			auto to_dot
+			    = obstacle.normal_x[i] * to.x + obstacle.normal_y[i] * to.y;
+			if (from_dot > limit && to_dot > limit)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (auto point : {from, to})
+	{
+		T x = obstacle.rotate_x[0] * point.x + obstacle.rotate_y[0] * point.y
+		      + obstacle.rotate_offset[0];
+		T y = obstacle.rotate_x[1] * point.x + obstacle.rotate_y[1] * point.y
+		      + obstacle.rotate_offset[1];
+		if (x >= obstacle.box_min[0] && y >= obstacle.box_min[1]
+		    && x <= obstacle.box_max[0] && y <= obstacle.box_max[1])
+		{
+			return true;
+		}
+	}
+
+	auto &corner_x = obstacle.corner_x[expand_level];
+	auto &corner_y = obstacle.corner_y[expand_level];
+	T dont_care, dont_care_2;
+	for (size_t i = 0; i < 4; i++)
+	{
+		if (LineLineIntersect(
+		        from.x,
+		        from.y,
+		        to.x,
+		        to.y,
+		        corner_x[i],
+		        corner_y[i],
+		        corner_x[(i + 1) % 4],
+		        corner_y[(i + 1) % 4],
+		        dont_care,
+		        dont_care_2))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename T>
+bool scalar_any_intersects(
+    const BasicPackedObstacle<T> *obstacles,
+    const uint32_t *indices,
+    size_t count,
+    vec2_of<T> from,
+    vec2_of<T> to,
+    size_t expand_level)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (scalar_intersects(obstacles[indices[i]], from, to, expand_level))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef CORONA_SIM_HAS_AVX2_KERNEL
+//is_within for four values at once
+__attribute__((target("avx2"))) inline __m256d
+avx2_within(__m256d value, __m256d low, __m256d high)
+{
+	return _mm256_and_pd(
+	    _mm256_cmp_pd(
+	        _mm256_sub_pd(low, value),
+	        _mm256_set1_pd(intersect_epsilon),
+	        _CMP_LE_OQ),
+	    _mm256_cmp_pd(
+	        _mm256_sub_pd(high, value),
+	        _mm256_set1_pd(-intersect_epsilon),
+	        _CMP_GE_OQ));
+}
+
+//every step mirrors the scalar code lane for lane, so the results are bit
+//for bit the same, only the four edges are handled at once
+__attribute__((target("avx2"))) bool avx2_intersects(
+    const PackedObstacle &obstacle,
+    glm::dvec2 from,
+    glm::dvec2 to,
+    size_t expand_level)
+{
+	auto expand = ObstacleGeometry::cached_expands[expand_level];
+	__m256d from_x = _mm256_set1_pd(from.x), from_y = _mm256_set1_pd(from.y);
+	__m256d to_x = _mm256_set1_pd(to.x), to_y = _mm256_set1_pd(to.y);
+
+	if (obstacle.has_positive_size)
+	{
+		__m256d normal_x = _mm256_load_pd(obstacle.normal_x.data());
+		__m256d normal_y = _mm256_load_pd(obstacle.normal_y.data());
+		__m256d limit = _mm256_add_pd(
+		    _mm256_add_pd(
+		        _mm256_load_pd(obstacle.normal_offset.data()),
+		        _mm256_set1_pd(expand)),
+		    _mm256_set1_pd(intersect_margin));
+		__m256d from_dot = _mm256_add_pd(
+		    _mm256_mul_pd(normal_x, from_x),
+		    _mm256_mul_pd(normal_y, from_y));
+		__m256d to_dot = _mm256_add_pd(
+		    _mm256_mul_pd(normal_x, to_x),
+		    _mm256_mul_pd(normal_y, to_y));
+		__m256d outside = _mm256_and_pd(
+		    _mm256_cmp_pd(from_dot, limit, _CMP_GT_OQ),
+		    _mm256_cmp_pd(to_dot, limit, _CMP_GT_OQ));
+		if (_mm256_movemask_pd(outside) != 0)
+		{
+			return false;
+		}
+	}
+
+	//lanes are {from.x, from.y, to.x, to.y} after the transform
+	__m256d points_x = _mm256_setr_pd(from.x, from.x, to.x, to.x);
+	__m256d points_y = _mm256_setr_pd(from.y, from.y, to.y, to.y);
+	__m256d local = _mm256_add_pd(
+	    _mm256_add_pd(
+	        _mm256_mul_pd(_mm256_load_pd(obstacle.rotate_x.data()), points_x),
+	        _mm256_mul_pd(_mm256_load_pd(obstacle.rotate_y.data()), points_y)),
+	    _mm256_load_pd(obstacle.rotate_offset.data()));
+	__m256d inside = _mm256_and_pd(
+	    _mm256_cmp_pd(local, _mm256_load_pd(obstacle.box_min.data()), _CMP_GE_OQ),
+	    _mm256_cmp_pd(local, _mm256_load_pd(obstacle.box_max.data()), _CMP_LE_OQ));
+	int inside_mask = _mm256_movemask_pd(inside);
+	if ((inside_mask & 0b0011) == 0b0011 || (inside_mask & 0b1100) == 0b1100)
+	{
+		return true;
+	}
+
+	//LineLineIntersect against all four edges
+	__m256d x3 = _mm256_load_pd(obstacle.corner_x[expand_level].data());
+	__m256d y3 = _mm256_load_pd(obstacle.corner_y[expand_level].data());
+	__m256d x4 = _mm256_permute4x64_pd(x3, _MM_SHUFFLE(0, 3, 2, 1));
+	__m256d y4 = _mm256_permute4x64_pd(y3, _MM_SHUFFLE(0, 3, 2, 1));
+
+	__m256d det_l1 = _mm256_set1_pd(from.x * to.y - from.y * to.x);
+	__m256d det_l2
+	    = _mm256_sub_pd(_mm256_mul_pd(x3, y4), _mm256_mul_pd(y3, x4));
+	__m256d x1mx2 = _mm256_set1_pd(from.x - to.x);
+	__m256d y1my2 = _mm256_set1_pd(from.y - to.y);
+	__m256d x3mx4 = _mm256_sub_pd(x3, x4);
+	__m256d y3my4 = _mm256_sub_pd(y3, y4);
+
+	__m256d x_nom = _mm256_sub_pd(
+	    _mm256_mul_pd(det_l1, x3mx4),
+	    _mm256_mul_pd(x1mx2, det_l2));
+	__m256d y_nom = _mm256_sub_pd(
+	    _mm256_mul_pd(det_l1, y3my4),
+	    _mm256_mul_pd(y1my2, det_l2));
+	__m256d denom = _mm256_sub_pd(
+	    _mm256_mul_pd(x1mx2, y3my4),
+	    _mm256_mul_pd(y1my2, x3mx4));
+	__m256d ix = _mm256_div_pd(x_nom, denom);
+	__m256d iy = _mm256_div_pd(y_nom, denom);
+
+	//a zero denominator always ends up here as inf or nan
+	__m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffff));
+	__m256d infinity = _mm256_set1_pd(INFINITY);
+	__m256d hit = _mm256_and_pd(
+	    _mm256_cmp_pd(_mm256_and_pd(ix, abs_mask), infinity, _CMP_LT_OQ),
+	    _mm256_cmp_pd(_mm256_and_pd(iy, abs_mask), infinity, _CMP_LT_OQ));
+
+	hit = _mm256_and_pd(
+	    hit,
+	    avx2_within(
+	        ix,
+	        _mm256_set1_pd(std::min(from.x, to.x)),
+	        _mm256_set1_pd(std::max(from.x, to.x))));
+	hit = _mm256_and_pd(
+	    hit,
+	    avx2_within(
+	        iy,
+	        _mm256_set1_pd(std::min(from.y, to.y)),
+	        _mm256_set1_pd(std::max(from.y, to.y))));
+	hit = _mm256_and_pd(
+	    hit,
+	    avx2_within(ix, _mm256_min_pd(x3, x4), _mm256_max_pd(x3, x4)));
+	hit = _mm256_and_pd(
+	    hit,
+	    avx2_within(iy, _mm256_min_pd(y3, y4), _mm256_max_pd(y3, y4)));
+	return _mm256_movemask_pd(hit) != 0;
+}
+
+__attribute__((target("avx2"))) bool avx2_any_intersects(
+    const PackedObstacle *obstacles,
+    const uint32_t *indices,
+    size_t count,
+    glm::dvec2 from,
+    glm::dvec2 to,
+    size_t expand_level)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (avx2_intersects(obstacles[indices[i]], from, to, expand_level))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//is_within for eight floats at once
+__attribute__((target("avx2"))) inline __m256
+avx2_within(__m256 value, __m256 low, __m256 high)
+{
+	return _mm256_and_ps(
+	    _mm256_cmp_ps(
+	        _mm256_sub_ps(low, value),
+	        _mm256_set1_ps(static_cast<float>(intersect_epsilon)),
+	        _CMP_LE_OQ),
+	    _mm256_cmp_ps(
+	        _mm256_sub_ps(high, value),
+	        _mm256_set1_ps(-static_cast<float>(intersect_epsilon)),
+	        _CMP_GE_OQ));
+}
+
+//{a[0..4], b[0..4]} in one register
+__attribute__((target("avx2"))) inline __m256
+avx2_pair(const std::array<float, 4> &a, const std::array<float, 4> &b)
+{
+	return _mm256_set_m128(_mm_load_ps(b.data()), _mm_load_ps(a.data()));
+}
+
+//float version of avx2_intersects, the low half of every register belongs
+//to obstacle a and the high half to obstacle b, so two obstacles are tested
+//per pass, returns a two bit mask of which of them the segment hits
+__attribute__((target("avx2"))) int avx2_intersects_pair(
+    const BasicPackedObstacle<float> &a,
+    const BasicPackedObstacle<float> &b,
+    glm::vec2 from,
+    glm::vec2 to,
+    size_t expand_level)
+{
+	auto expand = static_cast<float>(ObstacleGeometry::cached_expands[expand_level]);
+	__m256 from_x = _mm256_set1_ps(from.x), from_y = _mm256_set1_ps(from.y);
+	__m256 to_x = _mm256_set1_ps(to.x), to_y = _mm256_set1_ps(to.y);
+
+	__m256 normal_x = avx2_pair(a.normal_x, b.normal_x);
+	__m256 normal_y = avx2_pair(a.normal_y, b.normal_y);
+	__m256 limit = _mm256_add_ps(
+	    _mm256_add_ps(
+	        avx2_pair(a.normal_offset, b.normal_offset),
+	        _mm256_set1_ps(expand)),
+	    _mm256_set1_ps(static_cast<float>(intersect_margin)));
+	__m256 from_dot = _mm256_add_ps(
+	    _mm256_mul_ps(normal_x, from_x),
+	    _mm256_mul_ps(normal_y, from_y));
+	__m256 to_dot = _mm256_add_ps(
+	    _mm256_mul_ps(normal_x, to_x),
+	    _mm256_mul_ps(normal_y, to_y));
+	int outside_mask = _mm256_movemask_ps(_mm256_and_ps(
+	    _mm256_cmp_ps(from_dot, limit, _CMP_GT_OQ),
+	    _mm256_cmp_ps(to_dot, limit, _CMP_GT_OQ)));
+	bool separated_a = a.has_positive_size && (outside_mask & 0x0f) != 0;
+	bool separated_b = b.has_positive_size && (outside_mask & 0xf0) != 0;
+	if (separated_a && separated_b)
+	{
+		return 0;
+	}
+
+	//lanes are {from.x, from.y, to.x, to.y} per obstacle after the transform
+	__m256 points_x = _mm256_setr_ps(
+	    from.x, from.x, to.x, to.x, from.x, from.x, to.x, to.x);
+	__m256 points_y = _mm256_setr_ps(
+	    from.y, from.y, to.y, to.y, from.y, from.y, to.y, to.y);
+	__m256 local = _mm256_add_ps(
+	    _mm256_add_ps(
+	        _mm256_mul_ps(avx2_pair(a.rotate_x, b.rotate_x), points_x),
+	        _mm256_mul_ps(avx2_pair(a.rotate_y, b.rotate_y), points_y)),
+	    avx2_pair(a.rotate_offset, b.rotate_offset));
+	int inside_mask = _mm256_movemask_ps(_mm256_and_ps(
+	    _mm256_cmp_ps(local, avx2_pair(a.box_min, b.box_min), _CMP_GE_OQ),
+	    _mm256_cmp_ps(local, avx2_pair(a.box_max, b.box_max), _CMP_LE_OQ)));
+	auto point_inside = [](int mask) {
+		return (mask & 0b0011) == 0b0011 || (mask & 0b1100) == 0b1100;
+	};
+
+	//LineLineIntersect against all eight edges
+	__m256 x3 = avx2_pair(a.corner_x[expand_level], b.corner_x[expand_level]);
+	__m256 y3 = avx2_pair(a.corner_y[expand_level], b.corner_y[expand_level]);
+	__m256 x4 = _mm256_permute_ps(x3, _MM_SHUFFLE(0, 3, 2, 1));
+	__m256 y4 = _mm256_permute_ps(y3, _MM_SHUFFLE(0, 3, 2, 1));
+
+	__m256 det_l1 = _mm256_set1_ps(from.x * to.y - from.y * to.x);
+	__m256 det_l2 = _mm256_sub_ps(_mm256_mul_ps(x3, y4), _mm256_mul_ps(y3, x4));
+	__m256 x1mx2 = _mm256_set1_ps(from.x - to.x);
+	__m256 y1my2 = _mm256_set1_ps(from.y - to.y);
+	__m256 x3mx4 = _mm256_sub_ps(x3, x4);
+	__m256 y3my4 = _mm256_sub_ps(y3, y4);
+
+	__m256 x_nom = _mm256_sub_ps(
+	    _mm256_mul_ps(det_l1, x3mx4),
+	    _mm256_mul_ps(x1mx2, det_l2));
+	__m256 y_nom = _mm256_sub_ps(
+	    _mm256_mul_ps(det_l1, y3my4),
+	    _mm256_mul_ps(y1my2, det_l2));
+	__m256 denom = _mm256_sub_ps(
+	    _mm256_mul_ps(x1mx2, y3my4),
+	    _mm256_mul_ps(y1my2, x3mx4));
+	__m256 ix = _mm256_div_ps(x_nom, denom);
+	__m256 iy = _mm256_div_ps(y_nom, denom);
+
+	__m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	__m256 infinity = _mm256_set1_ps(INFINITY);
+	__m256 hit = _mm256_and_ps(
+	    _mm256_cmp_ps(_mm256_and_ps(ix, abs_mask), infinity, _CMP_LT_OQ),
+	    _mm256_cmp_ps(_mm256_and_ps(iy, abs_mask), infinity, _CMP_LT_OQ));
+	hit = _mm256_and_ps(
+	    hit,
+	    avx2_within(
+	        ix,
+	        _mm256_set1_ps(std::min(from.x, to.x)),
+	        _mm256_set1_ps(std::max(from.x, to.x))));
+	hit = _mm256_and_ps(
+	    hit,
+	    avx2_within(
+	        iy,
+	        _mm256_set1_ps(std::min(from.y, to.y)),
+	        _mm256_set1_ps(std::max(from.y, to.y))));
+	hit = _mm256_and_ps(
+	    hit,
+	    avx2_within(ix, _mm256_min_ps(x3, x4), _mm256_max_ps(x3, x4)));
+	hit = _mm256_and_ps(
+	    hit,
+	    avx2_within(iy, _mm256_min_ps(y3, y4), _mm256_max_ps(y3, y4)));
+	int hit_mask = _mm256_movemask_ps(hit);
+
+	int result = 0;
+	if (!separated_a && (point_inside(inside_mask) || (hit_mask & 0x0f) != 0))
+	{
+		result |= 1;
+	}
+	if (!separated_b
+	    && (point_inside(inside_mask >> 4) || (hit_mask & 0xf0) != 0))
+	{
+		result |= 2;
+	}
+	return result;
+}
+
+__attribute__((target("avx2"))) bool avx2_any_intersects_single(
+    const BasicPackedObstacle<float> *obstacles,
+    const uint32_t *indices,
+    size_t count,
+    glm::vec2 from,
+    glm::vec2 to,
+    size_t expand_level)
+{
+	for (size_t i = 0; i < count; i += 2)
+	{
+		//an odd one out is paired with itself
+		auto &second = obstacles[indices[std::min(i + 1, count - 1)]];
+		if (avx2_intersects_pair(
+		        obstacles[indices[i]],
+		        second,
+		        from,
+		        to,
+		        expand_level))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+#endif
+
+template <typename T>
+using AnyIntersects = bool (*)(
+    const BasicPackedObstacle<T> *,
+    const uint32_t *,
+    size_t,
+    vec2_of<T>,
+    vec2_of<T>,
+    size_t);
+
+struct Dispatch
+{
+	AnyIntersects<double> any_intersects = scalar_any_intersects<double>;
+	AnyIntersects<float> any_intersects_single = scalar_any_intersects<float>;
+	const char *name = "scalar";
+
+	Dispatch()
+	{
+#ifdef CORONA_SIM_HAS_AVX2_KERNEL
+		if (__builtin_cpu_supports("avx2"))
+		{
+			any_intersects = avx2_any_intersects;
+			any_intersects_single = avx2_any_intersects_single;
+			name = "avx2";
+		}
+#endif
+	}
+};
+
+const Dispatch &dispatch()
+{
+	static const Dispatch chosen;
+	return chosen;
+}
+} // namespace
+
+template <typename T>
+BasicPackedObstacle<T>::BasicPackedObstacle(const Obstacle &obstacle)
+{
+	auto &geometry = obstacle.geometry();
+	auto &matrix = geometry.inverse_rotation;
+	auto repeat = [](double x, double y) {
+		return std::array<T, 4>{
+		    static_cast<T>(x),
+		    static_cast<T>(y),
+		    static_cast<T>(x),
+		    static_cast<T>(y)};
+	};
+	rotate_x = repeat(matrix[0][0], matrix[0][1]);
+	rotate_y = repeat(matrix[1][0], matrix[1][1]);
+	rotate_offset = repeat(matrix[3][0], matrix[3][1]);
+
+	auto max = obstacle.position + obstacle.size;
+	box_min = repeat(obstacle.position.x, obstacle.position.y);
+	box_max = repeat(max.x, max.y);
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		normal_x[i] = static_cast<T>(geometry.edge_normals[i].x);
+		normal_y[i] = static_cast<T>(geometry.edge_normals[i].y);
+		normal_offset[i] = static_cast<T>(geometry.edge_offsets[i]);
+	}
+	for (size_t level = 0; level < ObstacleGeometry::cached_expands.size();
+	     level++)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			corner_x[level][i] = static_cast<T>(geometry.vertecies[level][i].x);
+			corner_y[level][i] = static_cast<T>(geometry.vertecies[level][i].y);
+		}
+	}
+	has_positive_size = geometry.has_positive_size;
+	blocks_movement = obstacle.blocks_movement;
+	blocks_infection = obstacle.blocks_infection;
+}
+
+template struct BasicPackedObstacle<double>;
+template struct BasicPackedObstacle<float>;
+
+bool SegmentKernel::any_intersects(
+    const BasicPackedObstacle<double> *obstacles,
+    const uint32_t *indices,
+    size_t count,
+    vec2_of<double> from,
+    vec2_of<double> to,
+    size_t expand_level)
+{
+	return dispatch().any_intersects(
+	    obstacles,
+	    indices,
+	    count,
+	    from,
+	    to,
+	    expand_level);
+}
+
+bool SegmentKernel::any_intersects(
+    const BasicPackedObstacle<float> *obstacles,
+    const uint32_t *indices,
+    size_t count,
+    vec2_of<float> from,
+    vec2_of<float> to,
+    size_t expand_level)
+{
+	return dispatch().any_intersects_single(
+	    obstacles,
+	    indices,
+	    count,
+	    from,
+	    to,
+	    expand_level);
+}
+
+const char *SegmentKernel::implementation_name() { return dispatch().name; }
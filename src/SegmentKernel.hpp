@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/ext.hpp>
+
+#include "Precision.hpp"
+
+struct Obstacle;
+
+//everything the segment test needs from one obstacle, laid out so that the
+//four edges (or both segment ends) fill one 4 wide register, for floats two
+//obstacles share one 8 wide register
+template <typename T>
+struct alignas(32) BasicPackedObstacle
+{
+	//rows of the inverse rotation, interleaved to transform both segment ends
+	//at once: {m00, m01, m00, m01}, {m10, m11, m10, m11}, {m30, m31, m30, m31}
+	std::array<T, 4> rotate_x, rotate_y, rotate_offset;
+	//the unrotated rectangle, repeated for both segment ends
+	std::array<T, 4> box_min, box_max;
+	//outwards edge normals and plane offsets, see ObstacleGeometry
+	std::array<T, 4> normal_x, normal_y, normal_offset;
+	//corner i starts edge i, one set per ObstacleGeometry::cached_expands
+	std::array<std::array<T, 4>, 3> corner_x, corner_y;
+	bool has_positive_size;
+	bool blocks_movement;
+	bool blocks_infection;
+
+	BasicPackedObstacle() = default;
+	explicit BasicPackedObstacle(const Obstacle &obstacle);
+};
+using PackedObstacle = BasicPackedObstacle<double>;
+
+//batched version of Obstacle::intersects(from, to, expand) for the cached
+//expands, picks an AVX2 implementation at runtime when the cpu has it
+//both implementations give exactly the same answers as the scalar code in
+//world.cpp, which relies on the build not contracting floating point math
+//the float overload does the same in single precision, so it matches the
+//double one except for segments grazing an obstacle
+class SegmentKernel
+{
+	public:
+	//true if the segment hits any of obstacles[indices[0 .. count]]
+	static bool any_intersects(
+	    const BasicPackedObstacle<double> *obstacles,
+	    const uint32_t *indices,
+	    size_t count,
+	    vec2_of<double> from,
+	    vec2_of<double> to,
+	    size_t expand_level);
+	static bool any_intersects(
+	    const BasicPackedObstacle<float> *obstacles,
+	    const uint32_t *indices,
+	    size_t count,
+	    vec2_of<float> from,
+	    vec2_of<float> to,
+	    size_t expand_level);
+
+	static const char *implementation_name();
+};
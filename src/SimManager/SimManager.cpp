@@ -3,6 +3,8 @@
 #include <fstream>
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <numbers>
 #include <sstream>
 
@@ -69,11 +71,14 @@ void SimManager::MoveStep(double dt)
 
 				if (current_time >= current_action.when)
 				{
-					person.going_along = m_world.calculate_path(
-					    person.floor,
-					    person.position,
-					    current_action.where.first,
-					    current_action.where.second);
+					//planned with everyone else's after the loop, the
+					//person only sets off next tick anyway
+					m_path_queries.push_back(
+					    {person.floor,
+					     person.position,
+					     current_action.where.first,
+					     current_action.where.second,
+					     &person.going_along});
 					person.going_to = 0;
 					person.routine_step++;
 				}
@@ -104,13 +109,16 @@ void SimManager::MoveStep(double dt)
 			    = rotate * glm::dvec4{person.current_direction, 0, 0};
 			person.current_direction = glm::normalize(person.current_direction);
 			person.noise_seed += 0.1 * dt;
+			sim_vec2 wander_from = person.position;
+			sim_vec2 wander_to
+			    = person.position + person.current_direction * 0.01 * dt;
 			if (m_world.test_line_of_sight(
 			        person.floor,
-			        person.position,
-			        person.position + person.current_direction * 0.01 * dt,
+			        wander_from,
+			        wander_to,
 			        true,
 			        false,
-			        0.02))
+			        sim_scalar(0.02)))
 			{
 				person.position
 				    = person.position + person.current_direction * 0.01 * dt;
@@ -165,10 +173,93 @@ void SimManager::MoveStep(double dt)
 			}
 		}
 	}
+	m_world.calculate_paths(m_path_queries);
+	m_path_queries.clear();
+
+	for (auto &person : m_current_people)
+	{
+		person.room = m_world.locate_room(person.floor, person.position);
+	}
 }
 
 void SimManager::InfectStep(double dt)
 {
+	//line of sight for every pair that can be tested this step is resolved up
+	//front, in (infector, target) order, pairs the rooms cannot decide go
+	//through one batch per floor
+	//people that get infected during the step fall back to single queries
+	struct InfectionPair
+	{
+		size_t infector;
+		size_t target;
+	};
+	std::vector<InfectionPair> pairs;
+	std::map<int, std::vector<size_t>> pairs_by_floor;
+	for (size_t first_person_iter = 0;
+	     first_person_iter < m_current_people.size();
+	     first_person_iter++)
+	{
+		auto &first_person = m_current_people[first_person_iter];
+		if (first_person.state != Person::infected)
+		{
+			continue;
+		}
+		for (size_t second_person_iter = 0;
+		     second_person_iter < m_current_people.size();
+		     second_person_iter++)
+		{
+			auto &second_person = m_current_people[second_person_iter];
+			if (first_person_iter == second_person_iter
+			    || second_person.state != Person::susceptible
+			    || first_person.floor != second_person.floor
+			    || glm::distance(
+			           sim_vec2{first_person.position},
+			           sim_vec2{second_person.position})
+			           > sim_scalar(maximum_infection_range))
+			{
+				continue;
+			}
+			pairs.push_back({first_person_iter, second_person_iter});
+		}
+	}
+	auto pair_line_of_sight = std::make_unique<bool[]>(pairs.size());
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		auto &infector = m_current_people[pairs[i].infector];
+		auto &target = m_current_people[pairs[i].target];
+		if (auto decided
+		    = RoomMap::infection_line_of_sight(infector.room, target.room))
+		{
+			pair_line_of_sight[i] = *decided;
+		}
+		else
+		{
+			pairs_by_floor[infector.floor].push_back(i);
+		}
+	}
+	std::vector<SimLineSegment> segments;
+	for (auto &[floor, indices] : pairs_by_floor)
+	{
+		segments.clear();
+		for (auto index : indices)
+		{
+			segments.push_back(
+			    {m_current_people[pairs[index].infector].position,
+			     m_current_people[pairs[index].target].position});
+		}
+		auto visible = std::make_unique<bool[]>(segments.size());
+		m_world.test_line_of_sight_batch(
+		    floor,
+		    segments,
+		    {.infection = true},
+		    {visible.get(), segments.size()});
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			pair_line_of_sight[indices[i]] = visible[i];
+		}
+	}
+	size_t next_pair = 0;
+
 	for (size_t first_person_iter = 0;
 	     first_person_iter < m_current_people.size();
 	     first_person_iter++)
@@ -189,18 +280,42 @@ void SimManager::InfectStep(double dt)
 			{
 				continue;
 			}
-			auto distance
-			    = glm::distance(first_person.position, second_person.position);
-			if (distance > maximum_infection_range)
+			auto distance = glm::distance(
+			    sim_vec2{first_person.position},
+			    sim_vec2{second_person.position});
+			if (distance > sim_scalar(maximum_infection_range))
 			{
 				continue;
 			}
-			if (!m_world.test_line_of_sight(
-			        first_person.floor,
-			        first_person.position,
-			        second_person.position,
-			        false,
-			        true))
+			while (next_pair < pairs.size()
+			       && std::pair(pairs[next_pair].infector, pairs[next_pair].target)
+			              < std::pair(first_person_iter, second_person_iter))
+			{
+				next_pair++;
+			}
+			bool line_of_sight;
+			if (next_pair < pairs.size()
+			    && pairs[next_pair].infector == first_person_iter
+			    && pairs[next_pair].target == second_person_iter)
+			{
+				line_of_sight = pair_line_of_sight[next_pair];
+			}
+			else if (auto decided = RoomMap::infection_line_of_sight(
+			             first_person.room,
+			             second_person.room))
+			{
+				line_of_sight = *decided;
+			}
+			else
+			{
+				line_of_sight = m_world.test_line_of_sight(
+				    first_person.floor,
+				    sim_vec2{first_person.position},
+				    sim_vec2{second_person.position},
+				    false,
+				    true);
+			}
+			if (!line_of_sight)
 			{
 				continue;
 			}
@@ -248,6 +363,194 @@ void SimManager::DrawUI(glm::dvec2 mouse_location)
 		mousewheel_sensitivity = wheel_sens / 100.0;
 		ImGui::TreePop();
 	}
+	if (bool wait = m_world.get_wait_for_fresh_graphs();
+	    ImGui::Checkbox("Wait for fresh visibility graphs", &wait))
+	{
+		m_world.set_wait_for_fresh_graphs(wait);
+	}
+	if (ImGui::TreeNode("Line of Sight Cache"))
+	{
+		auto settings = m_world.get_line_of_sight_cache_settings();
+		bool changed = ImGui::Checkbox("Enabled", &settings.enabled);
+		int capacity = static_cast<int>(settings.capacity);
+		if (ImGui::InputInt("Entries per floor", &capacity))
+		{
+			settings.capacity = static_cast<size_t>(std::max(capacity, 1));
+			changed = true;
+		}
+		changed |= ImGui::InputDouble(
+		    "Endpoint quantum",
+		    &settings.quantum,
+		    0,
+		    0,
+		    "%.1e");
+		settings.quantum = std::max(settings.quantum, 0.0);
+		if (changed)
+		{
+			m_world.set_line_of_sight_cache_settings(settings);
+		}
+
+		auto stats = m_world.get_line_of_sight_cache_stats();
+		auto lookups = stats.hits + stats.misses;
+		ImGui::Text(
+		    "hits: %llu, misses: %llu (%.1f%% hit rate)",
+		    static_cast<unsigned long long>(stats.hits),
+		    static_cast<unsigned long long>(stats.misses),
+		    lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups);
+		ImGui::Text(
+		    "entries: %zu, evictions: %llu",
+		    stats.entries,
+		    static_cast<unsigned long long>(stats.evictions));
+		if (ImGui::Button("Reset counters"))
+		{
+			m_world.reset_line_of_sight_cache_stats();
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Flow Fields"))
+	{
+		auto settings = m_world.get_flow_field_settings();
+		bool changed = ImGui::Checkbox("Enabled", &settings.enabled);
+		int hot_after = static_cast<int>(settings.hot_after);
+		if (ImGui::InputInt("Queries before a field", &hot_after))
+		{
+			settings.hot_after = static_cast<size_t>(std::max(hot_after, 1));
+			changed = true;
+		}
+		int capacity = static_cast<int>(settings.capacity);
+		if (ImGui::InputInt("Fields per floor", &capacity))
+		{
+			settings.capacity = static_cast<size_t>(std::max(capacity, 1));
+			changed = true;
+		}
+		int idle = static_cast<int>(settings.idle_queries);
+		if (ImGui::InputInt("Queries until unused", &idle))
+		{
+			settings.idle_queries = static_cast<uint64_t>(std::max(idle, 1));
+			changed = true;
+		}
+		if (changed)
+		{
+			m_world.set_flow_field_settings(settings);
+		}
+
+		auto stats = m_world.get_flow_field_stats();
+		ImGui::Text(
+		    "hits: %llu, builds: %llu, evictions: %llu",
+		    static_cast<unsigned long long>(stats.hits),
+		    static_cast<unsigned long long>(stats.builds),
+		    static_cast<unsigned long long>(stats.evictions));
+		ImGui::Text(
+		    "fields: %zu, %.1f KiB",
+		    stats.fields,
+		    stats.bytes / 1024.0);
+		if (ImGui::Button("Reset counters"))
+		{
+			m_world.reset_flow_field_stats();
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Path Cache"))
+	{
+		auto settings = m_world.get_path_cache_settings();
+		bool changed = ImGui::Checkbox("Enabled", &settings.enabled);
+		int capacity = static_cast<int>(settings.capacity);
+		if (ImGui::InputInt("Paths", &capacity))
+		{
+			settings.capacity = static_cast<size_t>(std::max(capacity, 1));
+			changed = true;
+		}
+		if (ImGui::InputDouble("Longest detour", &settings.max_detour))
+		{
+			settings.max_detour = std::max(settings.max_detour, 1.0);
+			changed = true;
+		}
+		if (changed)
+		{
+			m_world.set_path_cache_settings(settings);
+		}
+
+		auto stats = m_world.get_path_cache_stats();
+		auto lookups = stats.hits + stats.misses;
+		ImGui::Text(
+		    "hits: %llu, misses: %llu (%.1f%% hit rate)",
+		    static_cast<unsigned long long>(stats.hits),
+		    static_cast<unsigned long long>(stats.misses),
+		    lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups);
+		ImGui::Text(
+		    "entries: %zu, invalidations: %llu, evictions: %llu",
+		    stats.entries,
+		    static_cast<unsigned long long>(stats.invalidations),
+		    static_cast<unsigned long long>(stats.evictions));
+		ImGui::Text(
+		    "without a vertex in sight: %llu, too long: %llu",
+		    static_cast<unsigned long long>(stats.unsnapped),
+		    static_cast<unsigned long long>(stats.too_long));
+		if (ImGui::Button("Reset counters"))
+		{
+			m_world.reset_path_cache_stats();
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Landmarks"))
+	{
+		auto settings = m_world.get_landmark_settings();
+		int count = static_cast<int>(settings.count);
+		if (ImGui::InputInt("Landmarks per floor", &count))
+		{
+			settings.count = static_cast<size_t>(std::clamp(count, 0, 64));
+			m_world.set_landmark_settings(settings);
+		}
+
+		auto stats = m_world.get_landmark_stats();
+		ImGui::Text(
+		    "landmarks: %zu, %zu KiB, builds: %llu",
+		    stats.landmarks,
+		    stats.bytes / 1024,
+		    static_cast<unsigned long long>(stats.builds));
+		ImGui::Text(
+		    "searches: %llu, nodes closed per search: %.1f",
+		    static_cast<unsigned long long>(stats.searches),
+		    stats.searches == 0
+		        ? 0.0
+		        : static_cast<double>(stats.expansions) / stats.searches);
+		if (ImGui::Button("Reset counters"))
+		{
+			m_world.reset_landmark_stats();
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Route Tables"))
+	{
+		auto settings = m_world.get_route_table_settings();
+		bool changed = ImGui::Checkbox("Enabled", &settings.enabled);
+		int max_vertecies = static_cast<int>(settings.max_vertecies);
+		if (ImGui::InputInt("Max vertecies", &max_vertecies))
+		{
+			settings.max_vertecies
+			    = static_cast<size_t>(std::max(max_vertecies, 0));
+			changed = true;
+		}
+		if (changed)
+		{
+			m_world.set_route_table_settings(settings);
+		}
+
+		auto stats = m_world.get_route_table_stats();
+		ImGui::Text(
+		    "vertecies: %zu, %zu KiB, builds: %llu",
+		    stats.vertecies,
+		    stats.bytes / 1024,
+		    static_cast<unsigned long long>(stats.builds));
+		ImGui::Text(
+		    "queries answered: %llu",
+		    static_cast<unsigned long long>(stats.queries));
+		if (ImGui::Button("Reset counters"))
+		{
+			m_world.reset_route_table_stats();
+		}
+		ImGui::TreePop();
+	}
 	if (SimRunning)
 	{
 		ImGui::Text("Simulation is running");
@@ -260,6 +563,7 @@ void SimManager::DrawUI(glm::dvec2 mouse_location)
 	{
 		SimRunning = true;
 		m_current_people = m_simulation_start_people;
+		m_world.start_visibility_graph_rebuilds();
 		sim_time = 0;
 		if (m_selection_box)
 		{
@@ -341,6 +645,40 @@ void SimManager::DrawUI(glm::dvec2 mouse_location)
 				{
 					m_world.set_floor_group(floor.first, group);
 				}
+				bool pruned = floor.second.get_visibility_graph_pruning();
+				if (ImGui::Checkbox("bitangent edges only", &pruned))
+				{
+					m_world.set_visibility_graph_pruning(floor.first, pruned);
+				}
+				bool nav_mesh = floor.second.pathing_backend
+				                == PathingBackend::nav_mesh;
+				if (ImGui::Checkbox("navmesh pathing", &nav_mesh))
+				{
+					m_world.set_pathing_backend(
+					    floor.first,
+					    nav_mesh ? PathingBackend::nav_mesh
+					             : PathingBackend::visibility_graph);
+				}
+				if (nav_mesh)
+				{
+					auto &mesh = floor.second.get_nav_mesh();
+					ImGui::Text(
+					    "navmesh: %zu vertecies, %zu triangles, %.1f KiB",
+					    mesh.vertex_count(),
+					    mesh.triangle_count(),
+					    mesh.memory_bytes() / 1024.0);
+				}
+				auto &graph = floor.second.get_visibility_graph();
+				ImGui::Text(
+				    "visibility graph: %zu vertecies, %zu edges, %.1f KiB",
+				    graph.size(),
+				    graph.edge_count(),
+				    graph.memory_bytes() / 1024.0);
+				if (floor.second.rebuilding_visibility_graph())
+				{
+					ImGui::SameLine();
+					ImGui::Text("(rebuilding)");
+				}
 
 				if (ImGui::Button("Delete Floor"))
 				{
@@ -565,17 +903,26 @@ bool SimManager::PersonUI(Person &person)
 
 void SimManager::ObstacleUI(int floor, size_t index, bool &open)
 {
-	if (!m_world.get_layout().contains(floor) || SimRunning)
+	auto &layout = m_world.get_layout();
+	if (!layout.contains(floor) || !layout.at(floor).obstacles.contains(index)
+	    || SimRunning)
 	{
 		open = false;
 		return;
 	}
+	//only a change the widgets report counts as an edit
 	auto &obstacle = m_world.get_obstacle(floor, index);
-	if (ImGui::Checkbox("blocks movement", &obstacle.blocks_movement))
+	auto blocks_movement = obstacle.blocks_movement;
+	auto blocks_infection = obstacle.blocks_infection;
+	if (ImGui::Checkbox("blocks movement", &blocks_movement))
 	{
+		m_world.edit_obstacle(floor, index).blocks_movement = blocks_movement;
 		m_world.get_layout().at(floor).recalc();
 	}
-	ImGui::Checkbox("blocks infection", &obstacle.blocks_infection);
+	if (ImGui::Checkbox("blocks infection", &blocks_infection))
+	{
+		m_world.edit_obstacle(floor, index).blocks_infection = blocks_infection;
+	}
 	if (ImGui::Button("delete"))
 	{
 		m_world.remove_obstacle(floor, index);
@@ -721,9 +1068,10 @@ void SimManager::Click(glm::dvec2 click, bool ctrl)
 	{
 		if (is_visable(floor.first))
 		{
-			for (size_t i = 0; i < floor.second.obstacles.size(); i++)
+			auto &obstacles = floor.second.obstacles;
+			for (auto iter = obstacles.begin(); iter != obstacles.end(); ++iter)
 			{
-				auto &obstacle = floor.second.obstacles[i];
+				auto &obstacle = *iter;
 				auto center = obstacle.position + obstacle.size / 2.0;
 				auto rotate_around_obstacle
 				    = glm::translate(glm::dmat4{1}, glm::dvec3{center, 0})
@@ -743,7 +1091,7 @@ void SimManager::Click(glm::dvec2 click, bool ctrl)
 				{
 					m_selection_box = std::vector{
 					    decltype(m_selection_box)::value_type::value_type{
-					        std::pair(floor.first, i)}};
+					        std::pair(floor.first, iter.id())}};
 					return;
 				}
 			}
@@ -938,7 +1286,7 @@ void SimManager::UpdateDrag(glm::dvec2 where, glm::dvec2 delta)
 			else if (thing.index() == 1)
 			{
 				auto obstacle_index = std::get<1>(thing);
-				auto &obstacle = m_world.get_obstacle(
+				auto &obstacle = m_world.edit_obstacle(
 				    obstacle_index.first,
 				    obstacle_index.second);
 				obstacle.position -= last_drag - where;
@@ -963,7 +1311,7 @@ void SimManager::UpdateDrag(glm::dvec2 where, glm::dvec2 delta)
 	case RotatingObstacle: {
 		auto obstacle_index = std::get<1>(m_selection_box->at(0));
 		auto &obstacle
-		    = m_world.get_obstacle(obstacle_index.first, obstacle_index.second);
+		    = m_world.edit_obstacle(obstacle_index.first, obstacle_index.second);
 		auto center = obstacle.position + obstacle.size / 2.0;
 		auto last_drag_rel = last_drag - center;
 		auto where_rel = where - center;
@@ -982,7 +1330,7 @@ void SimManager::UpdateDrag(glm::dvec2 where, glm::dvec2 delta)
 			break;
 		}
 		auto &obstacle
-		    = m_world.get_obstacle(obstacle_index.first, obstacle_index.second);
+		    = m_world.edit_obstacle(obstacle_index.first, obstacle_index.second);
 		auto center = obstacle.position + obstacle.size / 2.0;
 		auto inverse_rotation
 		    = glm::translate(glm::dmat4{1}, glm::dvec3{center, 0})
@@ -1099,16 +1447,14 @@ void SimManager::StopDrag(glm::dvec2 where)
 					}
 				}
 			}
-			for (size_t i = 0;
-			     i < m_world.get_layout().at(floor).obstacles.size();
-			     ++i)
+			auto &obstacles = m_world.get_layout().at(floor).obstacles;
+			for (auto iter = obstacles.begin(); iter != obstacles.end(); ++iter)
 			{
-				auto &obstacle = m_world.get_layout().at(floor).obstacles.at(i);
-				if (selection.intersects(obstacle))
+				if (selection.intersects(*iter))
 				{
 					m_selection_box->emplace_back(
 					    std::in_place_index<1>,
-					    std::pair{floor, i});
+					    std::pair{floor, iter.id()});
 				}
 			}
 			if (m_selection_box->size() == 0)
@@ -1130,6 +1476,7 @@ void SimManager::LoadFromFile(std::string filename)
 	boost::archive::text_iarchive ar{file};
 	ar >> m_world;
 	ar >> m_simulation_start_people;
+	m_world.start_visibility_graph_rebuilds();
 }
 
 void SimManager::SaveToFile(std::string filename)
@@ -48,6 +48,8 @@ class SimManager
 	World m_world;
 	std::vector<Person> m_current_people;
 	std::vector<Person> m_simulation_start_people;
+	//the paths MoveStep plans in one go, kept for their capacity
+	std::vector<PathQuery> m_path_queries;
 	bool SimRunning = false;
 	std::function<double(std::optional<double>)> m_timescale;
 	double sim_time = 0;
@@ -0,0 +1,114 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+	for (size_t i = 1; i < thread_count; i++)
+	{
+		m_workers.emplace_back([this] { worker_loop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{m_mutex};
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+ThreadPool &ThreadPool::shared()
+{
+	static ThreadPool pool{std::max(1u, std::thread::hardware_concurrency())};
+	return pool;
+}
+
+std::shared_ptr<ThreadPool::Batch> ThreadPool::take_batch()
+{
+	std::lock_guard lock{m_mutex};
+	for (auto &spare : m_spare)
+	{
+		//a worker may still hold a finished batch for a moment, once the
+		//spare list is the only owner nobody can get at it anymore
+		if (spare.use_count() == 1)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			auto batch = std::move(spare);
+			spare = std::move(m_spare.back());
+			m_spare.pop_back();
+			batch->next = 0;
+			batch->done = 0;
+			return batch;
+		}
+	}
+	return std::make_shared<Batch>();
+}
+
+void ThreadPool::give_back(std::shared_ptr<Batch> batch)
+{
+	std::lock_guard lock{m_mutex};
+	m_spare.push_back(std::move(batch));
+}
+
+void ThreadPool::run(Batch &batch)
+{
+	while (true)
+	{
+		auto index = batch.next.fetch_add(1);
+		if (index >= batch.count)
+		{
+			return;
+		}
+		batch.body(index);
+		if (batch.done.fetch_add(1) + 1 == batch.count)
+		{
+			std::lock_guard lock{batch.mutex};
+			batch.finished.notify_all();
+		}
+	}
+}
+
+void ThreadPool::run_and_wait(const std::shared_ptr<Batch> &batch)
+{
+	{
+		std::lock_guard lock{m_mutex};
+		m_batches.push_back(batch);
+	}
+	m_wake.notify_all();
+
+	run(*batch);
+
+	std::unique_lock lock{batch->mutex};
+	batch->finished.wait(lock, [&] { return batch->done == batch->count; });
+}
+
+void ThreadPool::worker_loop()
+{
+	while (true)
+	{
+		std::shared_ptr<Batch> batch;
+		{
+			std::unique_lock lock{m_mutex};
+			m_wake.wait(lock, [this] { return m_stop || !m_batches.empty(); });
+			if (m_batches.empty())
+			{
+				return;
+			}
+			batch = m_batches.front();
+			//everything is claimed once next runs past count, nobody else
+			//needs to see this batch anymore
+			if (batch->next >= batch->count)
+			{
+				m_batches.erase(m_batches.begin());
+				continue;
+			}
+		}
+		run(*batch);
+	}
+}
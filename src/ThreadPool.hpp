@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//a fixed set of worker threads for splitting loops over many cores
+class ThreadPool
+{
+	public:
+	//thread_count includes the calling thread, so 1 runs everything inline
+	explicit ThreadPool(size_t thread_count);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	//one pool for the whole program, sized after the hardware
+	static ThreadPool &shared();
+
+	size_t thread_count() const { return m_workers.size() + 1; }
+
+	//runs body(i) for every i in [0, count) and returns once all are done
+	//the calling thread works on the loop as well, which also makes it fine
+	//to call parallel_for from inside another parallel_for
+	template <typename Body>
+	void parallel_for(size_t count, Body &&body);
+
+	private:
+	struct Batch
+	{
+		std::function<void(size_t)> body;
+		size_t count = 0;
+		std::atomic<size_t> next{0};
+		std::atomic<size_t> done{0};
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	//a spare batch nobody else holds anymore, or a new one
+	std::shared_ptr<Batch> take_batch();
+	void give_back(std::shared_ptr<Batch> batch);
+	void run(Batch &batch);
+	void run_and_wait(const std::shared_ptr<Batch> &batch);
+	void worker_loop();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	//oldest first, a vector so that it keeps its capacity
+	std::vector<std::shared_ptr<Batch>> m_batches;
+	//finished batches, reused so that a parallel_for allocates nothing once
+	//there are as many as run at the same time
+	std::vector<std::shared_ptr<Batch>> m_spare;
+	bool m_stop = false;
+};
+
+template <typename Body>
+void ThreadPool::parallel_for(size_t count, Body &&body)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	if (count == 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			body(i);
+		}
+		return;
+	}
+	auto batch = take_batch();
+	batch->body = [&body](size_t i) { body(i); };
+	batch->count = count;
+	run_and_wait(batch);
+	batch->body = nullptr;
+	give_back(std::move(batch));
+}
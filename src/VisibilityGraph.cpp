@@ -0,0 +1,247 @@
+#include "VisibilityGraph.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+VisibilityGraph::VisibilityGraph(std::vector<glm::dvec2> positions)
+    : m_positions(std::move(positions)), m_offsets(m_positions.size() + 1, 0)
+{
+	index_cells();
+}
+
+VisibilityGraph::VisibilityGraph(const AdjacencyLists &lists)
+    : VisibilityGraph()
+{
+	m_positions.reserve(lists.size());
+	m_offsets.reserve(lists.size() + 1);
+	for (auto &[position, neighbours] : lists)
+	{
+		m_positions.push_back(position);
+		m_offsets.push_back(m_offsets.back() + neighbours.size());
+	}
+	m_neighbours.reserve(m_offsets.back());
+	m_lengths.reserve(m_offsets.back());
+	for (size_t vertex = 0; vertex < lists.size(); vertex++)
+	{
+		for (auto neighbour : lists[vertex].second)
+		{
+			m_neighbours.push_back(static_cast<uint32_t>(neighbour));
+			m_lengths.push_back(
+			    glm::distance(m_positions[vertex], m_positions[neighbour]));
+		}
+	}
+	index_cells();
+}
+
+void VisibilityGraph::set_edges(
+    const std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &chunk_edges)
+{
+	//the pairs come in (i, j) order, so every vertex gets its lower
+	//neighbours first and its higher ones after them, both ascending
+	std::vector<size_t> degrees(m_positions.size(), 0);
+	for (auto &edges : chunk_edges)
+	{
+		for (auto [i, j] : edges)
+		{
+			degrees[i]++;
+			degrees[j]++;
+		}
+	}
+	m_offsets.assign(m_positions.size() + 1, 0);
+	for (size_t vertex = 0; vertex < m_positions.size(); vertex++)
+	{
+		m_offsets[vertex + 1] = m_offsets[vertex] + degrees[vertex];
+	}
+	m_neighbours.assign(m_offsets.back(), 0);
+	m_lengths.assign(m_offsets.back(), 0);
+	std::vector<size_t> next(m_offsets.begin(), m_offsets.end() - 1);
+	for (auto &edges : chunk_edges)
+	{
+		for (auto [i, j] : edges)
+		{
+			m_neighbours[next[i]] = j;
+			m_lengths[next[i]++] = glm::distance(m_positions[i], m_positions[j]);
+			m_neighbours[next[j]] = i;
+			m_lengths[next[j]++] = glm::distance(m_positions[j], m_positions[i]);
+		}
+	}
+}
+
+void VisibilityGraph::index_cells()
+{
+	auto finite = [](glm::dvec2 position) {
+		return std::isfinite(position.x) && std::isfinite(position.y);
+	};
+	glm::dvec2 low{std::numeric_limits<double>::max()};
+	glm::dvec2 high{std::numeric_limits<double>::lowest()};
+	for (auto position : m_positions)
+	{
+		if (finite(position))
+		{
+			low = glm::min(low, position);
+			high = glm::max(high, position);
+		}
+	}
+	m_cell_offsets.assign(1, 0);
+	m_cell_vertecies.clear();
+	m_columns = 0;
+	m_rows = 0;
+	if (low.x > high.x)
+	{
+		return;
+	}
+
+	auto extent = high - low;
+	auto side = static_cast<int>(
+	    std::ceil(std::sqrt(static_cast<double>(m_positions.size()))));
+	m_cell_min = low;
+	m_cell_size = std::max(extent.x, extent.y) / side;
+	if (!(m_cell_size > 0))
+	{
+		m_cell_size = 1;
+	}
+	m_columns = std::clamp(
+	    static_cast<int>(extent.x / m_cell_size) + 1,
+	    1,
+	    side + 1);
+	m_rows = std::clamp(
+	    static_cast<int>(extent.y / m_cell_size) + 1,
+	    1,
+	    side + 1);
+
+	//counted first, then placed, like the edges
+	auto cell_of = [&](glm::dvec2 position) {
+		auto column = std::min(
+		    static_cast<int>((position.x - low.x) / m_cell_size),
+		    m_columns - 1);
+		auto row = std::min(
+		    static_cast<int>((position.y - low.y) / m_cell_size),
+		    m_rows - 1);
+		return static_cast<size_t>(row) * m_columns + column;
+	};
+	m_cell_offsets.assign(static_cast<size_t>(m_columns) * m_rows + 1, 0);
+	for (auto position : m_positions)
+	{
+		if (finite(position))
+		{
+			m_cell_offsets[cell_of(position) + 1]++;
+		}
+	}
+	for (size_t cell = 1; cell < m_cell_offsets.size(); cell++)
+	{
+		m_cell_offsets[cell] += m_cell_offsets[cell - 1];
+	}
+	m_cell_vertecies.resize(m_cell_offsets.back());
+	std::vector<uint32_t> next(m_cell_offsets.begin(), m_cell_offsets.end() - 1);
+	for (size_t vertex = 0; vertex < m_positions.size(); vertex++)
+	{
+		if (finite(m_positions[vertex]))
+		{
+			m_cell_vertecies[next[cell_of(m_positions[vertex])]++]
+			    = static_cast<uint32_t>(vertex);
+		}
+	}
+}
+
+size_t VisibilityGraph::nearest(glm::dvec2 point, std::span<uint32_t> out)
+    const
+{
+	if (out.empty() || m_columns == 0 || !std::isfinite(point.x)
+	    || !std::isfinite(point.y))
+	{
+		return 0;
+	}
+	//the cell of point, or the nearest one if it is off the grid
+	auto clamped = [](double value, int count) {
+		return static_cast<int>(
+		    std::clamp(std::floor(value), 0.0, count - 1.0));
+	};
+	auto local = (point - m_cell_min) / m_cell_size;
+	int column = clamped(local.x, m_columns), row = clamped(local.y, m_rows);
+
+	//distances of the ones in out so far, kept sorted
+	constexpr size_t most = 16;
+	std::array<double, most> distances;
+	auto wanted = std::min(out.size(), most);
+	size_t count = 0;
+	auto consider = [&](int cell_column, int cell_row) {
+		auto cell = static_cast<size_t>(cell_row) * m_columns + cell_column;
+		for (auto i = m_cell_offsets[cell]; i < m_cell_offsets[cell + 1]; i++)
+		{
+			auto vertex = m_cell_vertecies[i];
+			auto distance = glm::distance(point, m_positions[vertex]);
+			//ties go to the lower index, whatever order the cells are in
+			auto before = [&](size_t at) {
+				return distance < distances[at]
+				       || (distance == distances[at] && vertex < out[at]);
+			};
+			if (count == wanted && !before(count - 1))
+			{
+				continue;
+			}
+			size_t at = count < wanted ? count++ : count - 1;
+			for (; at > 0 && before(at - 1); at--)
+			{
+				distances[at] = distances[at - 1];
+				out[at] = out[at - 1];
+			}
+			distances[at] = distance;
+			out[at] = vertex;
+		}
+	};
+	//ring by ring of cells around point's, everything past ring r is at
+	//least r cells away
+	auto rings = std::max(
+	    {column, row, m_columns - 1 - column, m_rows - 1 - row});
+	for (int ring = 0; ring <= rings; ring++)
+	{
+		if (count == wanted && distances[count - 1] <= (ring - 1) * m_cell_size)
+		{
+			break;
+		}
+		for (int r = row - ring; r <= row + ring; r++)
+		{
+			if (r < 0 || r >= m_rows)
+			{
+				continue;
+			}
+			//only the two ends of the inner rows belong to the ring
+			int step = r == row - ring || r == row + ring ? 1 : 2 * ring;
+			for (int c = column - ring; c <= column + ring;
+			     c += std::max(step, 1))
+			{
+				if (c >= 0 && c < m_columns)
+				{
+					consider(c, r);
+				}
+			}
+		}
+	}
+	return count;
+}
+
+size_t VisibilityGraph::memory_bytes() const
+{
+	return m_positions.capacity() * sizeof(glm::dvec2)
+	       + m_offsets.capacity() * sizeof(size_t)
+	       + m_neighbours.capacity() * sizeof(uint32_t)
+	       + m_lengths.capacity() * sizeof(double)
+	       + m_cell_offsets.capacity() * sizeof(uint32_t)
+	       + m_cell_vertecies.capacity() * sizeof(uint32_t);
+}
+
+VisibilityGraph::AdjacencyLists VisibilityGraph::adjacency_lists() const
+{
+	AdjacencyLists lists;
+	lists.reserve(size());
+	for (size_t vertex = 0; vertex < size(); vertex++)
+	{
+		auto row = neighbours(vertex);
+		lists.emplace_back(
+		    m_positions[vertex],
+		    std::vector<size_t>{row.begin(), row.end()});
+	}
+	return lists;
+}
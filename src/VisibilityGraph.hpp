@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <glm/ext.hpp>
+
+//a floor's visibility graph in compressed sparse row form
+//the neighbours of vertex i are m_neighbours[m_offsets[i], m_offsets[i + 1])
+//in ascending order, each with the length of its edge next to it
+//a graph is filled once by Floor and only read afterwards, so path queries
+//share it instead of copying it
+class VisibilityGraph
+{
+	public:
+	//the old adjacency list form, still used for save files
+	using AdjacencyLists
+	    = std::vector<std::pair<glm::dvec2, std::vector<size_t>>>;
+
+	VisibilityGraph() : m_offsets{0} {}
+	//vertecies without any edges
+	explicit VisibilityGraph(std::vector<glm::dvec2> positions);
+	explicit VisibilityGraph(const AdjacencyLists &lists);
+
+	//replaces the edges with the visible (i, j), i < j, pairs of the chunks,
+	//every chunk in ascending order and the chunks one after another
+	void set_edges(
+	    const std::vector<std::vector<std::pair<uint32_t, uint32_t>>>
+	        &chunk_edges);
+
+	size_t size() const { return m_positions.size(); }
+	size_t edge_count() const { return m_neighbours.size() / 2; }
+	glm::dvec2 position(size_t vertex) const { return m_positions[vertex]; }
+	std::span<const uint32_t> neighbours(size_t vertex) const
+	{
+		return {
+		    m_neighbours.data() + m_offsets[vertex],
+		    m_neighbours.data() + m_offsets[vertex + 1]};
+	}
+	//lengths[k] belongs to neighbours(vertex)[k]
+	std::span<const double> lengths(size_t vertex) const
+	{
+		return {
+		    m_lengths.data() + m_offsets[vertex],
+		    m_lengths.data() + m_offsets[vertex + 1]};
+	}
+
+	//the up to out.size() vertecies nearest to point into out, nearest
+	//first, returns how many were found, only the cells of a grid over the
+	//vertecies around point are looked at
+	size_t nearest(glm::dvec2 point, std::span<uint32_t> out) const;
+
+	//bytes allocated for the arrays
+	size_t memory_bytes() const;
+	AdjacencyLists adjacency_lists() const;
+
+	bool operator==(const VisibilityGraph &other) const = default;
+
+	private:
+	std::vector<glm::dvec2> m_positions;
+	std::vector<size_t> m_offsets;
+	std::vector<uint32_t> m_neighbours;
+	std::vector<double> m_lengths;
+
+	//sorts the vertecies into a square grid over them, about one per cell
+	void index_cells();
+
+	glm::dvec2 m_cell_min{0};
+	double m_cell_size = 1;
+	int m_columns = 0, m_rows = 0;
+	//the vertecies in cell c, row major, are
+	//m_cell_vertecies[m_cell_offsets[c], m_cell_offsets[c + 1]), ones that
+	//aren't finite are in none
+	std::vector<uint32_t> m_cell_offsets;
+	std::vector<uint32_t> m_cell_vertecies;
+};
@@ -0,0 +1,320 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "ThreadPool.hpp"
+
+//incremental version of Floor::build_visibility_graph for a few edited
+//obstacles
+//a pair of vertecies of untouched obstacles keeps its old answer unless an
+//edited obstacle's new footprint now blocks it, or its old footprint was what
+//blocked it, everything touching an edited obstacle's own vertecies is tested
+//again, so the result is exactly what a rebuild gives, with or without
+//pruning
+//only those pairs are looked at, the old edges, the pairs whose bounding box
+//overlaps an old footprint and the ones of the edited vertecies, the others
+//stay as they were without being visited
+
+namespace
+{
+//a changed obstacle as it was or is now
+struct Footprint
+{
+	glm::dvec2 min, max;
+	//index into the packed obstacles the footprint is tested with
+	uint32_t index;
+};
+
+Footprint footprint_of(const Obstacle &obstacle, uint32_t index)
+{
+	auto &corners = obstacle.geometry().vertecies[0];
+	glm::dvec2 min = corners[0], max = corners[0];
+	for (auto &corner : corners)
+	{
+		min = glm::min(min, corner);
+		max = glm::max(max, corner);
+	}
+	//no bounds at all, tested for every pair
+	if (!std::isfinite(min.x) || !std::isfinite(min.y) || !std::isfinite(max.x)
+	    || !std::isfinite(max.y))
+	{
+		constexpr double infinity = std::numeric_limits<double>::infinity();
+		return {glm::dvec2{-infinity}, glm::dvec2{infinity}, index};
+	}
+	return {min - intersect_margin, max + intersect_margin, index};
+}
+
+bool same_footprint(const Obstacle &a, const Obstacle &b)
+{
+	return a.position == b.position && a.size == b.size
+	       && a.rotation == b.rotation && a.blocks_movement == b.blocks_movement;
+}
+} // namespace
+
+void Floor::update_visibility_graph() const
+{
+	auto slot_limit
+	    = std::max(obstacles.slot_limit(), graph_obstacles.slot_limit());
+	std::vector<bool> changed(slot_limit, false);
+	bool any_changed = false;
+	for (auto slot : graph_changes)
+	{
+		bool was = graph_obstacles.occupied(slot), is = obstacles.occupied(slot);
+		if (was != is
+		    || (was && !same_footprint(graph_obstacles[slot], obstacles[slot])))
+		{
+			changed[slot] = true;
+			any_changed = true;
+		}
+	}
+	if (!any_changed)
+	{
+		return;
+	}
+
+	//footprints the old graph was built with and the ones there are now
+	std::vector<PackedObstacle> old_packed;
+	std::vector<Footprint> old_footprints, new_footprints;
+	for (size_t slot = 0; slot < slot_limit; slot++)
+	{
+		if (!changed[slot])
+		{
+			continue;
+		}
+		if (graph_obstacles.occupied(slot)
+		    && graph_obstacles[slot].blocks_movement)
+		{
+			auto &obstacle = graph_obstacles[slot];
+			old_footprints.push_back(footprint_of(
+			    obstacle,
+			    static_cast<uint32_t>(old_packed.size())));
+			old_packed.emplace_back(obstacle);
+		}
+		if (obstacles.occupied(slot) && obstacles[slot].blocks_movement)
+		{
+			new_footprints.push_back(
+			    footprint_of(obstacles[slot], static_cast<uint32_t>(slot)));
+		}
+	}
+	auto blocked_by = [](const std::vector<PackedObstacle> &packed,
+	                     const std::vector<Footprint> &footprints,
+	                     glm::dvec2 from,
+	                     glm::dvec2 to) {
+		auto min = glm::min(from, to), max = glm::max(from, to);
+		return std::ranges::any_of(footprints, [&](const Footprint &footprint) {
+			return !(max.x < footprint.min.x || min.x > footprint.max.x
+			         || max.y < footprint.min.y || min.y > footprint.max.y)
+			       && SegmentKernel::any_intersects(
+			           packed.data(),
+			           &footprint.index,
+			           1,
+			           from,
+			           to,
+			           0);
+		});
+	};
+
+	//the new vertecies, with the old index of the ones that stayed
+	constexpr size_t moved = std::numeric_limits<size_t>::max();
+	std::vector<size_t> old_ranks(slot_limit, moved);
+	size_t old_rank = 0;
+	for (auto iter = graph_obstacles.begin(); iter != graph_obstacles.end();
+	     ++iter, ++old_rank)
+	{
+		old_ranks[iter.slot()] = old_rank;
+	}
+	std::vector<glm::dvec2> positions;
+	std::vector<size_t> old_index;
+	for (auto iter = obstacles.begin(); iter != obstacles.end(); ++iter)
+	{
+		auto &vertecies = *iter->geometry().find_vertecies(0.011);
+		for (size_t corner = 0; corner < 4; corner++)
+		{
+			positions.push_back(vertecies[corner]);
+			old_index.push_back(
+			    changed[iter.slot()] ? moved
+			                         : old_ranks[iter.slot()] * 4 + corner);
+		}
+	}
+	auto old_graph = std::move(visibility_graph);
+	visibility_graph = std::make_shared<VisibilityGraph>(std::move(positions));
+
+	//an edit next to an untouched obstacle can bury or uncover its corners,
+	//their pairs are tested again
+	auto old_convex_corners = std::move(convex_corners);
+	find_convex_corners();
+	for (size_t i = 0; i < convex_corners.size(); i++)
+	{
+		if (old_index[i] != moved
+		    && convex_corners[i] != old_convex_corners[old_index[i]])
+		{
+			old_index[i] = moved;
+		}
+	}
+
+	auto vertex_count = visibility_graph->size();
+	//the new index of every old vertex that stayed, and the ones that
+	//didn't, ascending
+	std::vector<size_t> new_index(old_graph->size(), moved);
+	std::vector<uint32_t> moved_vertecies;
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		if (old_index[i] == moved)
+		{
+			moved_vertecies.push_back(static_cast<uint32_t>(i));
+		}
+		else
+		{
+			new_index[old_index[i]] = i;
+		}
+	}
+
+	//the pairs an old footprint could have blocked are the ones whose
+	//bounding box overlaps it, that is all but those with both vertecies on
+	//the same side of it along x or y, so the vertecies that stayed are
+	//sorted by the side they are on, 0 below, 1 across and 2 above on each
+	//axis, as side_x * 3 + side_y
+	auto side_of = [](double value, double min, double max) {
+		return value < min ? 0 : value > max ? 2 : 1;
+	};
+	auto sides_of = [&](const Footprint &footprint, glm::dvec2 vertex) {
+		return std::pair{
+		    side_of(vertex.x, footprint.min.x, footprint.max.x),
+		    side_of(vertex.y, footprint.min.y, footprint.max.y)};
+	};
+	std::vector<std::array<std::vector<uint32_t>, 9>> by_side(
+	    old_footprints.size());
+	for (size_t footprint = 0; footprint < old_footprints.size(); footprint++)
+	{
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			if (old_index[i] != moved)
+			{
+				auto [x, y] = sides_of(
+				    old_footprints[footprint],
+				    visibility_graph->position(i));
+				by_side[footprint][x * 3 + y].push_back(
+				    static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	//calls visit(j) for the vertecies j > i that stayed and make a pair with
+	//i whose bounding box overlaps the old footprint
+	auto for_each_overlapping = [&](size_t footprint, size_t i, auto &&visit) {
+		auto [x, y]
+		    = sides_of(old_footprints[footprint], visibility_graph->position(i));
+		for (int other = 0; other < 9; other++)
+		{
+			if ((other / 3 == x && x != 1) || (other % 3 == y && y != 1))
+			{
+				continue;
+			}
+			auto &side = by_side[footprint][other];
+			for (auto iter = std::upper_bound(side.begin(), side.end(), i);
+			     iter != side.end();
+			     ++iter)
+			{
+				visit(*iter);
+			}
+		}
+	};
+
+	auto chunk_rows = pair_row_chunks(vertex_count);
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> chunk_edges(
+	    chunk_rows.size() - 1);
+	ThreadPool::shared().parallel_for(chunk_edges.size(), [&](size_t chunk) {
+		auto &edges = chunk_edges[chunk];
+		std::vector<uint32_t> visible;
+		//row + 1 for the vertecies that row already looked at
+		std::vector<size_t> seen(vertex_count, 0);
+		auto test = [&](size_t i, size_t j) {
+			if (keeps_pair(i, j)
+			    && line_of_sight<double>(
+			        visibility_graph->position(i),
+			        visibility_graph->position(j),
+			        true,
+			        false,
+			        0.0))
+			{
+				visible.push_back(static_cast<uint32_t>(j));
+			}
+		};
+		for (size_t i = chunk_rows[chunk]; i < chunk_rows[chunk + 1]; ++i)
+		{
+			visible.clear();
+			if (old_index[i] == moved)
+			{
+				for (size_t j = i + 1; j < vertex_count; ++j)
+				{
+					test(i, j);
+				}
+			}
+			else
+			{
+				auto from = visibility_graph->position(i);
+				//whether a pair is pruned only depends on the obstacles of
+				//its two vertecies, the old edges between vertecies that
+				//stayed only have the new footprints to fear
+				auto old_neighbours = old_graph->neighbours(old_index[i]);
+				for (auto old_neighbour : old_neighbours)
+				{
+					auto j = new_index[old_neighbour];
+					if (j == moved || j <= i)
+					{
+						continue;
+					}
+					seen[j] = i + 1;
+					if (keeps_pair(i, j)
+					    && !blocked_by(
+					        packed_obstacles,
+					        new_footprints,
+					        from,
+					        visibility_graph->position(j)))
+					{
+						visible.push_back(static_cast<uint32_t>(j));
+					}
+				}
+				//the missing ones only if an old footprint was in the way
+				for (size_t footprint = 0; footprint < old_footprints.size();
+				     footprint++)
+				{
+					for_each_overlapping(footprint, i, [&](uint32_t j) {
+						if (seen[j] == i + 1)
+						{
+							return;
+						}
+						seen[j] = i + 1;
+						if (blocked_by(
+						        old_packed,
+						        old_footprints,
+						        from,
+						        visibility_graph->position(j)))
+						{
+							test(i, j);
+						}
+					});
+				}
+				//and every pair with a vertex of an edited obstacle
+				for (auto iter = std::upper_bound(
+				         moved_vertecies.begin(),
+				         moved_vertecies.end(),
+				         i);
+				     iter != moved_vertecies.end();
+				     ++iter)
+				{
+					test(i, *iter);
+				}
+				std::ranges::sort(visible);
+			}
+			for (auto j : visible)
+			{
+				edges.emplace_back(static_cast<uint32_t>(i), j);
+			}
+		}
+	});
+	visibility_graph->set_edges(chunk_edges);
+}
@@ -6,6 +6,7 @@
 #include <glm/ext.hpp>
 
 #include "PathResult.hpp"
+#include "RoomMap.hpp"
 
 struct Action
 {
@@ -76,6 +77,8 @@ class Person
 
 	double noise_seed = 3;
 	glm::dvec2 current_direction = {0, 1};
+	//refreshed every MoveStep, not saved
+	RoomId room;
 
 	private:
 	friend class boost::serialization::access;
@@ -1,28 +1,169 @@
 #include "world.hpp"
 
-#include "AStar.hpp"
+#include <algorithm>
+#include <numeric>
+#include <tuple>
 
-void World::add_obstacle(int floor, Obstacle obstacle)
+#include "BackgroundWorker.hpp"
+#include "ThreadPool.hpp"
+
+std::optional<size_t> World::add_obstacle(int floor, Obstacle obstacle)
+{
+	if (auto found = m_map.find(floor); found != m_map.end())
+	{
+		obstacle.invalidate_geometry();
+		auto id = found->second.obstacles.insert(obstacle);
+		found->second.obstacle_changed(id);
+		return id;
+	}
+	return std::nullopt;
+}
+
+void World::remove_obstacle(int floor, size_t obstacle)
 {
-	if (m_map.contains(floor))
+	if (auto found = m_map.find(floor); found != m_map.end())
 	{
-		m_map.at(floor).obstacles.push_back(obstacle);
-		m_map.at(floor).recalc();
+		found->second.obstacles.erase(obstacle);
+		found->second.obstacle_changed(obstacle);
 	}
 }
 
-void World::remove_obstacle(int floor, int obstacle)
+void World::remove_floor(int floor)
 {
-	if (m_map.contains(floor))
+	m_map.erase(floor);
+	m_changer_tables.erase(floor);
+}
+
+void World::add_floor(int floor)
+{
+	auto [added, inserted] = m_map.emplace(floor, Floor{});
+	if (inserted)
 	{
-		m_map[floor].obstacles.erase(m_map[floor].obstacles.begin() + obstacle);
-		m_map[floor].recalc();
+		added->second.get_line_of_sight_cache().configure(
+		    m_line_of_sight_cache_settings);
+		added->second.get_flow_fields().configure(m_flow_field_settings);
+		added->second.get_landmarks().configure(m_landmark_settings);
+		added->second.get_route_tables().configure(m_route_table_settings);
 	}
 }
 
-void World::remove_floor(int floor) { m_map.erase(floor); }
+template <typename Cache>
+void World::configure_floors(
+    FloorCache<Cache> cache,
+    typename Cache::Settings settings)
+{
+	for (auto &[index, floor] : m_map)
+	{
+		(floor.*cache)().configure(settings);
+	}
+}
+
+template <typename Cache>
+typename Cache::Stats World::floor_stats(FloorCache<Cache> cache) const
+{
+	typename Cache::Stats total;
+	for (auto &[index, floor] : m_map)
+	{
+		total += (floor.*cache)().stats();
+	}
+	return total;
+}
+
+template <typename Cache>
+void World::reset_floor_stats(FloorCache<Cache> cache)
+{
+	for (auto &[index, floor] : m_map)
+	{
+		(floor.*cache)().reset_stats();
+	}
+}
+
+void World::set_line_of_sight_cache_settings(
+    LineOfSightCache::Settings settings)
+{
+	m_line_of_sight_cache_settings = settings;
+	configure_floors(&Floor::get_line_of_sight_cache, settings);
+}
 
-void World::add_floor(int floor) { m_map.emplace(floor, Floor{}); }
+LineOfSightCache::Stats World::get_line_of_sight_cache_stats() const
+{
+	return floor_stats(&Floor::get_line_of_sight_cache);
+}
+
+void World::reset_line_of_sight_cache_stats()
+{
+	reset_floor_stats(&Floor::get_line_of_sight_cache);
+}
+
+void World::set_flow_field_settings(FlowFieldCache::Settings settings)
+{
+	m_flow_field_settings = settings;
+	configure_floors(&Floor::get_flow_fields, settings);
+}
+
+FlowFieldCache::Stats World::get_flow_field_stats() const
+{
+	return floor_stats(&Floor::get_flow_fields);
+}
+
+void World::reset_flow_field_stats()
+{
+	reset_floor_stats(&Floor::get_flow_fields);
+}
+
+void World::set_landmark_settings(LandmarkCache::Settings settings)
+{
+	m_landmark_settings = settings;
+	configure_floors(&Floor::get_landmarks, settings);
+}
+
+LandmarkCache::Stats World::get_landmark_stats() const
+{
+	return floor_stats(&Floor::get_landmarks);
+}
+
+void World::reset_landmark_stats()
+{
+	reset_floor_stats(&Floor::get_landmarks);
+}
+
+void World::set_route_table_settings(RouteTableCache::Settings settings)
+{
+	m_route_table_settings = settings;
+	configure_floors(&Floor::get_route_tables, settings);
+}
+
+RouteTableCache::Stats World::get_route_table_stats() const
+{
+	return floor_stats(&Floor::get_route_tables);
+}
+
+void World::reset_route_table_stats()
+{
+	reset_floor_stats(&Floor::get_route_tables);
+}
+
+void World::recalc_visibility_graphs() const
+{
+	std::vector<const Floor *> floors;
+	for (auto &[index, floor] : m_map)
+	{
+		floors.push_back(&floor);
+	}
+	//every floor splits its own pairs over the pool as well
+	ThreadPool::shared().parallel_for(floors.size(), [&](size_t i) {
+		floors[i]->recalc_visibility_graph();
+	});
+	update_changer_tables();
+}
+
+void World::start_visibility_graph_rebuilds() const
+{
+	for (auto &[index, floor] : m_map)
+	{
+		floor.start_visibility_graph_rebuild();
+	}
+}
 
 const decltype(World::m_map) &World::get_layout() const { return m_map; }
 
@@ -33,85 +174,382 @@ bool World::test_line_of_sight(
     bool movement,
     bool infection, double expand) const
 {
-	if (m_map.contains(floor))
+	if (auto found = m_map.find(floor); found != m_map.end())
 	{
-		return m_map.at(floor).test_line_of_sight(from, to, movement, infection, expand);
+		return found->second.test_line_of_sight(from, to, movement, infection, expand);
 	}
 	return true;
 }
 
+bool World::test_line_of_sight(
+    int floor,
+    vec2_of<float> from,
+    vec2_of<float> to,
+    bool movement,
+    bool infection,
+    float expand) const
+{
+	if (auto found = m_map.find(floor); found != m_map.end())
+	{
+		return found->second.test_line_of_sight(from, to, movement, infection, expand);
+	}
+	return true;
+}
+
+void World::test_line_of_sight_batch(
+    int floor,
+    std::span<const BasicLineSegment<double>> segments,
+    LineOfSightFlags flags,
+    std::span<bool> out) const
+{
+	if (auto found = m_map.find(floor); found != m_map.end())
+	{
+		found->second.test_line_of_sight_batch(segments, flags, out);
+		return;
+	}
+	std::fill(out.begin(), out.end(), true);
+}
+
+void World::test_line_of_sight_batch(
+    int floor,
+    std::span<const BasicLineSegment<float>> segments,
+    LineOfSightFlags flags,
+    std::span<bool> out) const
+{
+	if (auto found = m_map.find(floor); found != m_map.end())
+	{
+		found->second.test_line_of_sight_batch(segments, flags, out);
+		return;
+	}
+	std::fill(out.begin(), out.end(), true);
+}
+
+RoomId World::locate_room(int floor, glm::dvec2 point) const
+{
+	if (auto found = m_map.find(floor); found != m_map.end())
+	{
+		return found->second.locate_room(point);
+	}
+	return {};
+}
+
+RoomId Floor::locate_room(glm::dvec2 point) const
+{
+	if (needs_room_rebuild)
+	{
+		room_map.build(obstacles);
+		needs_room_rebuild = false;
+	}
+	return room_map.locate(point);
+}
+
+const NavMesh &Floor::get_nav_mesh() const
+{
+	if (needs_nav_mesh_rebuild)
+	{
+		update_line_of_sight_cache();
+		nav_mesh.build(obstacles, obstacle_grid);
+		needs_nav_mesh_rebuild = false;
+	}
+	return nav_mesh;
+}
+
+template <>
+const std::vector<BasicPackedObstacle<double>> &Floor::packed<double>() const
+{
+	return packed_obstacles;
+}
+
+template <>
+const std::vector<BasicPackedObstacle<float>> &Floor::packed<float>() const
+{
+	return packed_obstacles_single;
+}
+
 bool Floor::test_line_of_sight(
     glm::dvec2 from,
     glm::dvec2 to,
     bool movement,
     bool infection, double expand) const
 {
-	for (auto &obstacle : obstacles)
+	return cached_line_of_sight<double>(from, to, movement, infection, expand);
+}
+
+bool Floor::test_line_of_sight(
+    vec2_of<float> from,
+    vec2_of<float> to,
+    bool movement,
+    bool infection,
+    float expand) const
+{
+	return cached_line_of_sight<float>(from, to, movement, infection, expand);
+}
+
+template <typename T>
+bool Floor::cached_line_of_sight(
+    vec2_of<T> from,
+    vec2_of<T> to,
+    bool movement,
+    bool infection,
+    T expand) const
+{
+	LineOfSightCache::Query query{
+	    from,
+	    to,
+	    {movement, infection, static_cast<double>(expand)},
+	    std::is_same_v<T, float>};
+	if (auto cached = line_of_sight_cache.find(query))
 	{
-		if ((movement && obstacle.blocks_movement)
-		    || (infection && obstacle.blocks_infection))
+		return *cached;
+	}
+	bool visible = line_of_sight<T>(from, to, movement, infection, expand);
+	line_of_sight_cache.insert(query, visible);
+	return visible;
+}
+
+void Floor::test_line_of_sight_batch(
+    std::span<const BasicLineSegment<double>> segments,
+    LineOfSightFlags flags,
+    std::span<bool> out) const
+{
+	line_of_sight_batch(segments, flags, out);
+}
+
+void Floor::test_line_of_sight_batch(
+    std::span<const BasicLineSegment<float>> segments,
+    LineOfSightFlags flags,
+    std::span<bool> out) const
+{
+	line_of_sight_batch(segments, flags, out);
+}
+
+template <typename T>
+bool Floor::line_of_sight(
+    vec2_of<T> from,
+    vec2_of<T> to,
+    bool movement,
+    bool infection,
+    T expand) const
+{
+	auto &expands = ObstacleGeometry::cached_expands;
+	size_t level = std::ranges::find_if(
+	                   expands,
+	                   [&](double cached) {
+		                   return static_cast<T>(cached) == expand;
+	                   })
+	               - expands.begin();
+	if constexpr (!std::is_same_v<T, double>)
+	{
+		//only the cached expands have packed single precision data
+		if (level == expands.size())
 		{
-			if (obstacle.intersects(from, to, expand))
+			return line_of_sight<double>(
+			    from,
+			    to,
+			    movement,
+			    infection,
+			    static_cast<double>(expand));
+		}
+	}
+
+	auto blocks = [&](const Obstacle &obstacle) {
+		return ((movement && obstacle.blocks_movement)
+		        || (infection && obstacle.blocks_infection))
+		       && obstacle.intersects(from, to, expand);
+	};
+	if (expand < 0 || expand > ObstacleGrid::max_expand)
+	{
+		for (auto &obstacle : obstacles)
+		{
+			if (blocks(obstacle))
 			{
 				return false;
 			}
 		}
+		return true;
 	}
-	return true;
-}
-inline double Det(double a, double b, double c, double d)
-{
-	return a * d - b * c;
+	update_line_of_sight_cache();
+
+	if (level == expands.size())
+	{
+		return obstacle_grid.for_each_candidate(from, to, [&](size_t index) {
+			return !blocks(obstacles[index]);
+		});
+	}
+
+	//hand the candidates to the kernel a few at a time
+	auto &packed_obstacles = packed<T>();
+	std::array<uint32_t, 4> batch;
+	size_t batch_size = 0;
+	auto intersects_batch = [&] {
+		return SegmentKernel::any_intersects(
+		    packed_obstacles.data(),
+		    batch.data(),
+		    batch_size,
+		    from,
+		    to,
+		    level);
+	};
+	bool visible
+	    = obstacle_grid.for_each_candidate(from, to, [&](size_t index) {
+		      auto &packed = packed_obstacles[index];
+		      if (!(movement && packed.blocks_movement)
+		          && !(infection && packed.blocks_infection))
+		      {
+			      return true;
+		      }
+		      batch[batch_size++] = static_cast<uint32_t>(index);
+		      if (batch_size < batch.size())
+		      {
+			      return true;
+		      }
+		      bool hit = intersects_batch();
+		      batch_size = 0;
+		      return !hit;
+	      });
+	return visible && !intersects_batch();
 }
 
-bool LineLineIntersect(
-    double x1,
-    double y1, //Line 1 start
-    double x2,
-    double y2, //Line 1 end
-    double x3,
-    double y3, //Line 2 start
-    double x4,
-    double y4, //Line 2 end
-    double &ixOut,
-    double &iyOut) //Output
+template <typename T>
+void Floor::line_of_sight_batch(
+    std::span<const BasicLineSegment<T>> segments,
+    LineOfSightFlags flags,
+    std::span<bool> out) const
 {
-	//http://mathworld.wolfram.com/Line-LineIntersection.html
+	//below this sorting and waking threads costs more than it saves
+	constexpr size_t chunk_size = 256;
 
-	double detL1 = Det(x1, y1, x2, y2);
-	double detL2 = Det(x3, y3, x4, y4);
-	double x1mx2 = x1 - x2;
-	double x3mx4 = x3 - x4;
-	double y1my2 = y1 - y2;
-	double y3my4 = y3 - y4;
+	auto expand = static_cast<T>(flags.expand);
+	auto test = [&](size_t i) {
+		out[i] = line_of_sight<T>(
+		    segments[i].from,
+		    segments[i].to,
+		    flags.movement,
+		    flags.infection,
+		    expand);
+	};
+	update_line_of_sight_cache();
 
-	double xnom = Det(detL1, x1mx2, detL2, x3mx4);
-	double ynom = Det(detL1, y1my2, detL2, y3my4);
-	double denom = Det(x1mx2, y1my2, x3mx4, y3my4);
-	if (denom == 0.0) //Lines don't seem to cross
+	//the memo is only touched here on the calling thread, before and after
+	//the parallel part
+	auto query = [&](size_t i) {
+		return LineOfSightCache::Query{
+		    segments[i].from,
+		    segments[i].to,
+		    {flags.movement, flags.infection, static_cast<double>(expand)},
+		    std::is_same_v<T, float>};
+	};
+	//kept per thread, so a batch no bigger than an earlier one allocates
+	//nothing, and moved out for the call, the workers below would see their
+	//own copy and a batch started while this one waits needs one of its own
+	thread_local std::vector<uint32_t> kept_pending;
+	thread_local std::vector<std::pair<size_t, uint32_t>> kept_order;
+	auto pending = std::move(kept_pending);
+	auto order = std::move(kept_order);
+	pending.clear();
+	for (size_t i = 0; i < segments.size(); i++)
 	{
-		ixOut = NAN;
-		iyOut = NAN;
-		return false;
+		if (auto cached = line_of_sight_cache.find(query(i)))
+		{
+			out[i] = *cached;
+		}
+		else
+		{
+			pending.push_back(static_cast<uint32_t>(i));
+		}
 	}
+	auto remember = [&] {
+		if (line_of_sight_cache.enabled())
+		{
+			for (auto i : pending)
+			{
+				line_of_sight_cache.insert(query(i), out[i]);
+			}
+		}
+	};
 
-	ixOut = xnom / denom;
-	iyOut = ynom / denom;
-	if (!std::isfinite(ixOut)
-	    || !std::isfinite(iyOut)) //Probably a numerical issue
-		return false;
+	if (pending.size() <= chunk_size)
+	{
+		for (auto i : pending)
+		{
+			test(i);
+		}
+		remember();
+		kept_pending = std::move(pending);
+		kept_order = std::move(order);
+		return;
+	}
 
-	if (is_within(ixOut, x1, x2) && is_within(ixOut, x3, x4)
-	    && is_within(iyOut, y1, y2) && is_within(iyOut, y3, y4))
+	//neighbouring segments mostly look at the same obstacles, so handle
+	//them together while those are still in cache
+	order.resize(pending.size());
+	for (size_t i = 0; i < pending.size(); i++)
 	{
-		return true; //All OK
+		auto &segment = segments[pending[i]];
+		order[i] = {
+		    obstacle_grid.cell_key(
+		        (glm::dvec2{segment.from} + glm::dvec2{segment.to}) / 2.0),
+		    pending[i]};
 	}
+	std::sort(order.begin(), order.end());
 
-	return false;
+	ThreadPool::shared().parallel_for(
+	    (order.size() + chunk_size - 1) / chunk_size,
+	    [&](size_t chunk) {
+		    auto end = std::min(order.size(), (chunk + 1) * chunk_size);
+		    for (size_t i = chunk * chunk_size; i < end; i++)
+		    {
+			    test(order[i].second);
+		    }
+	    });
+	remember();
+	kept_pending = std::move(pending);
+	kept_order = std::move(order);
 }
 
-std::vector<glm::dvec2>
-Obstacle::get_vertecies(double expand_by, bool include_rotations /*=true*/) const
+void Floor::update_line_of_sight_cache() const
+{
+	if (needs_grid_rebuild || obstacle_grid.needs_rebuild())
+	{
+		//indexed by obstacle slot, free slots keep a stale entry the grid
+		//never hands out
+		packed_obstacles.resize(obstacles.slot_limit());
+		packed_obstacles_single.resize(obstacles.slot_limit());
+		for (auto iter = obstacles.begin(); iter != obstacles.end(); ++iter)
+		{
+			packed_obstacles[iter.slot()] = PackedObstacle{*iter};
+			packed_obstacles_single[iter.slot()]
+			    = BasicPackedObstacle<float>{*iter};
+		}
+		obstacle_grid.build(obstacles);
+		needs_grid_rebuild = false;
+		changed_obstacles.clear();
+		return;
+	}
+
+	if (!changed_obstacles.empty())
+	{
+		packed_obstacles.resize(obstacles.slot_limit());
+		packed_obstacles_single.resize(obstacles.slot_limit());
+		for (auto slot : changed_obstacles)
+		{
+			if (!obstacles.occupied(slot))
+			{
+				obstacle_grid.erase(slot);
+				continue;
+			}
+			auto &obstacle = obstacles[slot];
+			packed_obstacles[slot] = PackedObstacle{obstacle};
+			packed_obstacles_single[slot] = BasicPackedObstacle<float>{obstacle};
+			obstacle_grid.insert(slot, obstacle);
+		}
+		changed_obstacles.clear();
+	}
+}
+
+std::array<glm::dvec2, 4> Obstacle::calculate_vertecies(
+    double expand_by,
+    bool include_rotations) const
 {
 	auto center = (position * 2.0 + size) / 2.0;
 	auto rotate = glm::translate(
@@ -130,6 +568,128 @@ Obstacle::get_vertecies(double expand_by, bool include_rotations /*=true*/) cons
 	    glm::dvec2{rotate * glm::dvec3{position + glm::dvec2{0, size.y}, 1}}};
 }
 
+std::vector<glm::dvec2>
+Obstacle::get_vertecies(double expand_by, bool include_rotations /*=true*/) const
+{
+	if (include_rotations)
+	{
+		if (auto cached = geometry().find_vertecies(expand_by))
+		{
+			return {cached->begin(), cached->end()};
+		}
+	}
+	auto vertecies = calculate_vertecies(expand_by, include_rotations);
+	return {vertecies.begin(), vertecies.end()};
+}
+
+const ObstacleGeometry &Obstacle::geometry() const
+{
+	if (!geometry_dirty)
+	{
+		return cached_geometry;
+	}
+	for (size_t i = 0; i < ObstacleGeometry::cached_expands.size(); i++)
+	{
+		cached_geometry.vertecies[i]
+		    = calculate_vertecies(ObstacleGeometry::cached_expands[i], true);
+	}
+
+	auto center = position + size / 2.0;
+	cached_geometry.inverse_rotation
+	    = glm::translate(glm::dmat4{1}, glm::dvec3{center, 0})
+	      * glm::rotate(glm::dmat4{1}, -rotation, glm::dvec3{0, 0, 1})
+	      * glm::translate(glm::dmat4{1}, -glm::dvec3{center, 0});
+
+	auto &corners = cached_geometry.vertecies[0];
+	auto corner_center = (corners[0] + corners[2]) / 2.0;
+	for (size_t i = 0; i < 4; i++)
+	{
+		auto edge = corners[(i + 1) % 4] - corners[i];
+		auto normal = glm::normalize(glm::dvec2{edge.y, -edge.x});
+		if (glm::dot(normal, corner_center - corners[i]) > 0)
+		{
+			normal = -normal;
+		}
+		cached_geometry.edge_normals[i] = normal;
+		cached_geometry.edge_offsets[i] = glm::dot(normal, corners[i]);
+	}
+	cached_geometry.has_positive_size = size.x > 0 && size.y > 0
+	                                    && std::isfinite(size.x)
+	                                    && std::isfinite(size.y);
+
+	geometry_dirty = false;
+	return cached_geometry;
+}
+
+bool ObstacleGeometry::separated(
+    glm::dvec2 from,
+    glm::dvec2 to,
+    double expand) const
+{
+	if (!has_positive_size || expand < 0)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < 4; i++)
+	{
+		auto limit = edge_offsets[i] + expand + intersect_margin;
+		if (glm::dot(edge_normals[i], from) > limit
+		    && glm::dot(edge_normals[i], to) > limit)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ObstacleGeometry::overlaps(glm::dvec2 min, glm::dvec2 max) const
+{
+	//separating axis test of the corners against the box
+	auto &corners = vertecies[0];
+	glm::dvec2 corner_min = corners[0], corner_max = corners[0];
+	for (auto &corner : corners)
+	{
+		corner_min = glm::min(corner_min, corner);
+		corner_max = glm::max(corner_max, corner);
+	}
+	if (corner_max.x < min.x || corner_min.x > max.x || corner_max.y < min.y
+	    || corner_min.y > max.y)
+	{
+		return false;
+	}
+
+	std::array<glm::dvec2, 4> box{
+	    min,
+	    glm::dvec2{max.x, min.y},
+	    max,
+	    glm::dvec2{min.x, max.y}};
+	for (size_t i = 0; i < 2; i++)
+	{
+		auto edge = corners[i + 1] - corners[i];
+		glm::dvec2 axis{-edge.y, edge.x};
+		if (axis == glm::dvec2{0})
+		{
+			continue;
+		}
+		auto project = [&](const std::array<glm::dvec2, 4> &points) {
+			double low = glm::dot(axis, points[0]), high = low;
+			for (auto &point : points)
+			{
+				low = std::min(low, glm::dot(axis, point));
+				high = std::max(high, glm::dot(axis, point));
+			}
+			return std::pair{low, high};
+		};
+		auto [corner_low, corner_high] = project(corners);
+		auto [box_low, box_high] = project(box);
+		if (corner_high < box_low || corner_low > box_high)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 bool simple_point_AABB(glm::dvec2 point, const Obstacle &ob)
 {
 	auto result = glm::greaterThanEqual(point, ob.position)
@@ -139,40 +699,32 @@ bool simple_point_AABB(glm::dvec2 point, const Obstacle &ob)
 
 bool Obstacle::intersects(glm::dvec2 point) const
 {
-
-	auto center = position + size / 2.0;
-	auto rotate = glm::translate(glm::dmat4{1}, glm::dvec3{center, 0})
-	              * glm::rotate(glm::dmat4{1}, -rotation, glm::dvec3{0, 0, 1})
-	              * glm::translate(glm::dmat4{1}, -glm::dvec3{center, 0});
-	return simple_point_AABB(rotate * glm::dvec4{point, 0, 1}, *this);
+	return simple_point_AABB(
+	    geometry().inverse_rotation * glm::dvec4{point, 0, 1},
+	    *this);
 }
 
 bool Obstacle::intersects(const Obstacle &other) const
 {
-	auto my_center = position + size / 2.0;
-	auto my_rotate = glm::translate(glm::dmat4{1}, glm::dvec3{my_center, 0})
-	                 * glm::rotate(glm::dmat4{1}, -rotation, glm::dvec3{0, 0, 1})
-	                 * glm::translate(glm::dmat4{1}, -glm::dvec3{my_center, 0});
+	auto &my_geometry = geometry();
+	auto &other_geometry = other.geometry();
 
-	auto other_points = other.get_vertecies(0);
-	for (auto &point : other_points)
+	for (auto &point : other_geometry.vertecies[0])
 	{
-		if (simple_point_AABB(my_rotate * glm::dvec4{point, 0, 1}, *this))
+		if (simple_point_AABB(
+		        my_geometry.inverse_rotation * glm::dvec4{point, 0, 1},
+		        *this))
 		{
 			return true;
 		}
 	}
 
-	auto other_center = other.position + other.size / 2.0;
-	auto other_rotate
-	    = glm::translate(glm::dmat4{1}, glm::dvec3{other_center, 0})
-	      * glm::rotate(glm::dmat4{1}, -other.rotation, glm::dvec3{0, 0, 1})
-	      * glm::translate(glm::dmat4{1}, -glm::dvec3{other_center, 0});
-
-	auto my_points = get_vertecies(0);
+	auto &my_points = my_geometry.vertecies[0];
 	for (auto &point : my_points)
 	{
-		if (simple_point_AABB(other_rotate * glm::dvec4{point, 0, 1}, other))
+		if (simple_point_AABB(
+		        other_geometry.inverse_rotation * glm::dvec4{point, 0, 1},
+		        other))
 		{
 			return true;
 		}
@@ -186,275 +738,524 @@ bool Obstacle::intersects(const Obstacle &other) const
 
 bool Obstacle::intersects(glm::dvec2 from, glm::dvec2 to, double expand) const
 {
+	auto &geometry = this->geometry();
+	if (geometry.separated(from, to, expand))
+	{
+		return false;
+	}
 	if (intersects(from) || intersects(to))
 	{
 		return true;
 	}
-	auto vertecies = get_vertecies(expand);
+	std::array<glm::dvec2, 4> calculated;
+	auto vertecies = geometry.find_vertecies(expand);
+	if (!vertecies)
+	{
+		calculated = calculate_vertecies(expand, true);
+		vertecies = &calculated;
+	}
 	double dont_care, dont_care_2;
-	return LineLineIntersect(
-	           from.x,
-	           from.y,
-	           to.x,
-	           to.y,
-	           vertecies[0].x,
-	           vertecies[0].y,
-	           vertecies[1].x,
-	           vertecies[1].y,
-	           dont_care,
-	           dont_care_2)
-	       || LineLineIntersect(
-	           from.x,
-	           from.y,
-	           to.x,
-	           to.y,
-	           vertecies[1].x,
-	           vertecies[1].y,
-	           vertecies[2].x,
-	           vertecies[2].y,
-	           dont_care,
-	           dont_care_2)
-	       || LineLineIntersect(
-	           from.x,
-	           from.y,
-	           to.x,
-	           to.y,
-	           vertecies[2].x,
-	           vertecies[2].y,
-	           vertecies[3].x,
-	           vertecies[3].y,
-	           dont_care,
-	           dont_care_2)
-	       || LineLineIntersect(
-	           from.x,
-	           from.y,
-	           to.x,
-	           to.y,
-	           vertecies[3].x,
-	           vertecies[3].y,
-	           vertecies[0].x,
-	           vertecies[0].y,
-	           dont_care,
-	           dont_care_2);
-}
-
-const std::vector<std::pair<glm::dvec2, std::vector<size_t>>> &
-Floor::recalc_visibility_graph() const
+	for (size_t i = 0; i < 4; i++)
+	{
+		auto &start = (*vertecies)[i];
+		auto &end = (*vertecies)[(i + 1) % 4];
+		if (LineLineIntersect(
+		        from.x,
+		        from.y,
+		        to.x,
+		        to.y,
+		        start.x,
+		        start.y,
+		        end.x,
+		        end.y,
+		        dont_care,
+		        dont_care_2))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const VisibilityGraph &Floor::recalc_visibility_graph() const
 {
+	adopt_graph_job(true);
 	if (!needs_recalc)
+	{
+		return *visibility_graph;
+	}
+	update_line_of_sight_cache();
+	//an edit of a few obstacles only has to look at the pairs they can block
+	if (!needs_graph_rebuild && graph_changes.size() <= max_graph_changes)
+	{
+		update_visibility_graph();
+	}
+	else
+	{
+		build_visibility_graph();
+	}
+	graph_obstacles = obstacles;
+	graph_changes.clear();
+	needs_graph_rebuild = false;
+	needs_recalc = false;
+	graph_published = true;
+	return *visibility_graph;
+}
+
+std::shared_ptr<const VisibilityGraph>
+Floor::visibility_graph_snapshot(bool wait_for_fresh) const
+{
+	if (in_path_batch)
 	{
 		return visibility_graph;
 	}
-	visibility_graph.clear();
-	for (auto &obstacle : obstacles)
+	adopt_graph_job(false);
+	if (needs_recalc && (wait_for_fresh || !graph_published))
 	{
-		auto vertecies = obstacle.get_vertecies(0.011);
-		visibility_graph.emplace_back(vertecies[0], std::vector<size_t>{});
-		visibility_graph.emplace_back(vertecies[1], std::vector<size_t>{});
-		visibility_graph.emplace_back(vertecies[2], std::vector<size_t>{});
-		visibility_graph.emplace_back(vertecies[3], std::vector<size_t>{});
+		recalc_visibility_graph();
 	}
+	else if (needs_recalc && !graph_job)
+	{
+		start_graph_job();
+	}
+	return visibility_graph;
+}
 
-	for (size_t i = 0; i < visibility_graph.size(); ++i)
+void Floor::start_visibility_graph_rebuild() const
+{
+	adopt_graph_job(false);
+	if (needs_recalc && !graph_job)
 	{
-		auto &vertex = visibility_graph[i];
-		for (size_t j = i + 1; j < visibility_graph.size(); ++j)
+		start_graph_job();
+	}
+}
+
+void Floor::begin_path_batch(bool wait_for_fresh) const
+{
+	visibility_graph_snapshot(wait_for_fresh);
+	update_line_of_sight_cache();
+	if (pathing_backend == PathingBackend::nav_mesh)
+	{
+		get_nav_mesh();
+	}
+	line_of_sight_cache.hold(true);
+	flow_fields.hold(true);
+	in_path_batch = true;
+}
+
+void Floor::end_path_batch() const
+{
+	in_path_batch = false;
+	line_of_sight_cache.hold(false);
+	flow_fields.hold(false);
+}
+
+void Floor::start_graph_job() const
+{
+	//the copy takes the incremental update state along, edits made while
+	//it runs collect in graph_changes again
+	auto job = std::make_shared<VisibilityGraphJob>();
+	auto &copy = job->floor;
+	copy.obstacles = obstacles;
+	copy.visibility_graph_pruning = visibility_graph_pruning;
+	copy.visibility_graph = visibility_graph;
+	copy.graph_obstacles = std::move(graph_obstacles);
+	copy.graph_changes = std::move(graph_changes);
+	copy.needs_graph_rebuild = needs_graph_rebuild;
+	copy.convex_corners = convex_corners;
+	copy.needs_recalc = true;
+	graph_obstacles = {};
+	graph_changes.clear();
+	needs_graph_rebuild = false;
+	job->version = graph_version;
+	graph_job = job;
+	BackgroundWorker::shared().submit([job] {
+		job->floor.recalc_visibility_graph();
 		{
-			auto &other_vertex = visibility_graph[j];
-			if (test_line_of_sight(
-			        vertex.first,
-			        other_vertex.first,
-			        true,
-			        false))
-			{
-				vertex.second.push_back(j);
-				other_vertex.second.push_back(i);
-			}
+			std::lock_guard lock{job->mutex};
+			job->done = true;
 		}
-	}
-	needs_recalc = false;
-	return visibility_graph;
+		job->finished.notify_all();
+	});
 }
 
-PathResult World::calculate_path(
-    int from_floor,
-    glm::dvec2 from,
-    int to_floor,
-    glm::dvec2 to) const
+void Floor::adopt_graph_job(bool wait) const
 {
-	auto floor_pathing = floor_path(from_floor, to_floor);
-	if (floor_pathing)
+	if (!graph_job)
 	{
-		//true = entering a, false = entering b
-		std::vector<std::pair<std::vector<glm::dvec2>, int>> all_path_results;
-		std::vector<std::pair<FloorChanger, bool>> all_floor_changers;
-		for (size_t i = 0; i < floor_pathing->size(); i++)
+		return;
+	}
+	{
+		std::unique_lock lock{graph_job->mutex};
+		if (!graph_job->done && !wait)
 		{
-			std::vector<glm::dvec2> to_next_floor;
-			std::vector<std::pair<FloorChanger, bool>> next_floor_changers;
-			if (i != floor_pathing->size() - 1)
-			{
-				for (auto &changer : floor_changers)
-				{
-					if (changer.a.first == floor_pathing->at(i)
-					    && changer.b.first == floor_pathing->at(i + 1))
-					{
-						to_next_floor.push_back(changer.a.second);
-						next_floor_changers.emplace_back(changer, true);
-					}
-					if (changer.b.first == floor_pathing->at(i)
-					    && changer.a.first == floor_pathing->at(i + 1))
-					{
-						to_next_floor.push_back(changer.b.second);
-						next_floor_changers.emplace_back(changer, false);
-					}
-				}
-			}
-			else
-			{
-				to_next_floor.push_back(to);
-			}
-			glm::dvec2 start;
-			if (i == 0)
-			{
-				start = from;
-			}
-			else
-			{
-				auto changer = all_floor_changers.back();
-				if (changer.second)
-				{
-					start = changer.first.b.second;
-				}
-				else
-				{
-					start = changer.first.a.second;
-				}
-			}
-			AStar Pather{
-			    start,
-			    to_next_floor,
-			    [this, &floor_pathing, &i](glm::dvec2 from, glm::dvec2 to) {
-				    return test_line_of_sight(
-				        floor_pathing->at(i),
-				        from,
-				        to,
-				        true,
-				        false);
-			    },
-			    m_map.at(floor_pathing->at(i)).recalc_visibility_graph()};
-			Pather.run();
+			return;
+		}
+		graph_job->finished.wait(lock, [&] { return graph_job->done; });
+	}
+	auto &built = graph_job->floor;
+	visibility_graph = built.visibility_graph;
+	graph_obstacles = built.graph_obstacles;
+	convex_corners = built.convex_corners;
+	graph_published = true;
+	needs_recalc = graph_version != graph_job->version;
+	graph_job = nullptr;
+}
 
-			auto results = Pather.path_result();
-			if (results)
-			{
-				all_path_results.push_back(*results);
-				if (i != floor_pathing->size() - 1)
-				{
-					all_floor_changers.push_back(
-					    next_floor_changers[results->second]);
-				}
-			}
-			else
-			{
-				PathResult a;
-				a.force_teleport = true;
-				a.waypoints.emplace_back(std::pair{to_floor, to});
-				return a;
-			}
+std::vector<size_t> Floor::pair_row_chunks(size_t vertex_count)
+{
+	//rows are handed out in chunks of about the same number of pairs, each
+	//chunk keeps its visible pairs in (i, j) order so appending them chunk by
+	//chunk gives every vertex the same neighbour order as a plain double loop
+	constexpr size_t pairs_per_chunk = 1 << 12;
+	std::vector<size_t> chunk_rows{0};
+	for (size_t row = 0, pairs = 0; row < vertex_count; row++)
+	{
+		pairs += vertex_count - row - 1;
+		if (pairs >= pairs_per_chunk || row + 1 == vertex_count)
+		{
+			chunk_rows.push_back(row + 1);
+			pairs = 0;
 		}
-		PathResult result;
-		for (size_t i = 0; i < all_path_results.size(); i++)
+	}
+	return chunk_rows;
+}
+
+void Floor::build_visibility_graph() const
+{
+	std::vector<glm::dvec2> positions;
+	positions.reserve(obstacles.size() * 4);
+	for (auto &obstacle : obstacles)
+	{
+		auto &vertecies = *obstacle.geometry().find_vertecies(0.011);
+		positions.insert(positions.end(), vertecies.begin(), vertecies.end());
+	}
+	visibility_graph = std::make_shared<VisibilityGraph>(std::move(positions));
+	find_convex_corners();
+
+	auto vertex_count = visibility_graph->size();
+	auto chunk_rows = pair_row_chunks(vertex_count);
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> chunk_edges(
+	    chunk_rows.size() - 1);
+	ThreadPool::shared().parallel_for(chunk_edges.size(), [&](size_t chunk) {
+		auto &edges = chunk_edges[chunk];
+		for (size_t i = chunk_rows[chunk]; i < chunk_rows[chunk + 1]; ++i)
 		{
-			for (auto &waypoint : all_path_results[i].first)
+			for (size_t j = i + 1; j < vertex_count; ++j)
 			{
-				result.waypoints.emplace_back(waypoint);
-			}
-			if (i != floor_pathing->size() - 1)
-			{
-				if (all_floor_changers[i].second)
-				{
-					result.waypoints.emplace_back(all_floor_changers[i].first.b);
-				}
-				else
+				if (keeps_pair(i, j)
+				    && line_of_sight<double>(
+				        visibility_graph->position(i),
+				        visibility_graph->position(j),
+				        true,
+				        false,
+				        0.0))
 				{
-					result.waypoints.emplace_back(all_floor_changers[i].first.a);
+					edges.emplace_back(i, j);
 				}
 			}
 		}
-		return result;
+	});
+	visibility_graph->set_edges(chunk_edges);
+}
+
+void Floor::find_convex_corners() const
+{
+	convex_corners.clear();
+	if (!visibility_graph_pruning)
+	{
+		return;
 	}
-	else
+	//the vertecies are the corners of the obstacles expanded by this, the
+	//pruned graph routes around those expanded obstacles
+	constexpr double expand = 0.011;
+	//keeps a vertex off its own obstacle and exact duplicates of it
+	constexpr double tolerance = 1e-9;
+	size_t vertex = 0;
+	for (auto &obstacle : obstacles)
 	{
-		PathResult a;
-		a.force_teleport = true;
-		a.waypoints.emplace_back(std::pair{to_floor, to});
-		return a;
+		for (size_t corner = 0; corner < 4; corner++, vertex++)
+		{
+			auto point = visibility_graph->position(vertex);
+			convex_corners.push_back(
+			    obstacle.blocks_movement
+			    && obstacle_grid.for_each_candidate(
+			        point,
+			        point,
+			        [&](size_t id) {
+				        auto &other = obstacles[id];
+				        auto &geometry = other.geometry();
+				        if (!other.blocks_movement
+				            || !geometry.has_positive_size)
+				        {
+					        return true;
+				        }
+				        for (size_t i = 0; i < 4; i++)
+				        {
+					        if (glm::dot(geometry.edge_normals[i], point)
+					            >= geometry.edge_offsets[i] + expand - tolerance)
+					        {
+						        return true;
+					        }
+				        }
+				        return false;
+			        }));
+		}
 	}
 }
 
-Obstacle &World::get_obstacle(int floor, size_t index)
+bool Floor::bitangent(size_t i, size_t j) const
 {
-	return m_map.at(floor).obstacles.at(index);
+	if (!convex_corners[i] || !convex_corners[j])
+	{
+		return false;
+	}
+	//a shortest path around the expanded obstacles only bends at a corner
+	//with the obstacle on the inside of the bend, so the line through both
+	//ends has both neighbouring corners of each end on the same side
+	auto direction = visibility_graph->position(j) - visibility_graph->position(i);
+	auto tangent = [&](size_t at) {
+		auto vertex = visibility_graph->position(at);
+		auto first = at - at % 4;
+		auto previous = visibility_graph->position(first + (at + 3) % 4);
+		auto next = visibility_graph->position(first + (at + 1) % 4);
+		auto side = [&](glm::dvec2 point) {
+			auto offset = point - vertex;
+			return direction.x * offset.y - direction.y * offset.x;
+		};
+		//lines along a side of the obstacle count despite rounding
+		auto tolerance
+		    = 1e-9 * glm::length(direction) * glm::distance(previous, next);
+		auto a = side(previous), b = side(next);
+		return !(a < -tolerance && b > tolerance)
+		       && !(a > tolerance && b < -tolerance);
+	};
+	return tangent(i) && tangent(j);
 }
 
-const Obstacle &World::get_obstacle(int floor, size_t index) const
+PathResult World::calculate_path(
+    int from_floor,
+    glm::dvec2 from,
+    int to_floor,
+    glm::dvec2 to) const
 {
-	return m_map.at(floor).obstacles.at(index);
+	PathResult result;
+	calculate_path(from_floor, from, to_floor, to, result);
+	return result;
 }
 
-void World::set_floor_name(int floor, std::string name)
+void World::calculate_path(
+    int from_floor,
+    glm::dvec2 from,
+    int to_floor,
+    glm::dvec2 to,
+    PathResult &result) const
 {
-	m_map.at(floor).name = name;
+	if (m_path_cache.enabled()
+	    && cached_path(from_floor, from, to_floor, to, result))
+	{
+		return;
+	}
+	plan_path(from_floor, from, to_floor, to, result);
 }
-void World::set_floor_group(int floor, std::string group)
+
+void World::begin_path_batch() const
 {
-	m_map.at(floor).group = group;
+	//nothing lazy is left for the queries to bring up to date, so they
+	//only read what they share
+	for (auto &[index, floor] : m_map)
+	{
+		floor.begin_path_batch(m_wait_for_fresh_graphs);
+	}
+	update_changer_tables();
+	m_path_cache.hold(true);
+	m_in_path_batch = true;
 }
 
-std::optional<std::vector<int>> World::floor_path(int from, int to) const
+void World::end_path_batch() const
 {
-	std::unordered_set<int> seen;
-	auto result = floor_path(from, to, seen);
-	if (result)
+	m_in_path_batch = false;
+	m_path_cache.hold(false);
+	for (auto &[index, floor] : m_map)
 	{
-		return {{result->rbegin(), result->rend()}};
+		floor.end_path_batch();
 	}
-	return std::nullopt;
 }
 
-std::optional<std::vector<int>>
-World::floor_path(int from, int to, std::unordered_set<int> &already_seen) const
+void World::calculate_paths(std::span<const PathQuery> queries) const
 {
-	if (from == to)
+	//identical queries are solved once, by the first of them
+	auto key = [&](size_t i) {
+		auto &query = queries[i];
+		return std::tuple{
+		    query.from_floor,
+		    query.from.x,
+		    query.from.y,
+		    query.to_floor,
+		    query.to.x,
+		    query.to.y};
+	};
+	auto &order = m_batch_order;
+	order.resize(queries.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::ranges::stable_sort(order, [&](size_t a, size_t b) {
+		return key(a) < key(b);
+	});
+	auto &solver = m_batch_solver;
+	solver.resize(queries.size());
+	size_t solved = 0;
+	for (size_t i = 0; i < order.size(); i++)
 	{
-		return {{to}};
+		if (i > 0 && key(order[i]) == key(order[i - 1]))
+		{
+			solver[order[i]] = solver[order[i - 1]];
+			continue;
+		}
+		solver[order[i]] = order[i];
+		//order is reused for the queries that are solved
+		order[solved++] = order[i];
 	}
-	already_seen.insert(from);
-	std::vector<int> options;
-	for (auto &changer : floor_changers)
+
+	begin_path_batch();
+	ThreadPool::shared().parallel_for(solved, [&](size_t i) {
+		auto &query = queries[order[i]];
+		calculate_path(
+		    query.from_floor,
+		    query.from,
+		    query.to_floor,
+		    query.to,
+		    *query.result);
+	});
+	end_path_batch();
+
+	for (size_t i = 0; i < queries.size(); i++)
 	{
-		if (changer.a.first == from)
+		if (solver[i] != i)
 		{
-			options.push_back(changer.b.first);
+			*queries[i].result = *queries[solver[i]].result;
 		}
-		if (changer.b.first == from)
+	}
+}
+
+void World::plan_path(
+    int from_floor,
+    glm::dvec2 from,
+    int to_floor,
+    glm::dvec2 to,
+    PathResult &result) const
+{
+	auto &context = search_context();
+	result.waypoints.clear();
+	result.force_teleport = false;
+	auto teleport = [&] {
+		result.waypoints.clear();
+		result.force_teleport = true;
+		result.waypoints.emplace_back(std::pair{to_floor, to});
+	};
+
+	auto &route = context.route;
+	route.clear();
+	if (from_floor != to_floor)
+	{
+		if (!changer_route(from_floor, from, to_floor, to, context))
 		{
-			options.push_back(changer.a.first);
+			teleport();
+			return;
 		}
 	}
-	for (auto option : options)
+	else if (!m_map.contains(from_floor))
+	{
+		teleport();
+		return;
+	}
+
+	//one leg per floor, each but the last one ends at a changer
+	auto floor = from_floor;
+	auto start = from;
+	for (size_t i = 0; i <= route.size(); i++)
 	{
-		if (already_seen.contains(option) || !m_map.contains(option))
+		std::optional<size_t> reached;
+		if (i == route.size())
 		{
-			continue;
+			reached = floor_route(floor, start, {&to, 1}, context);
+		}
+		else
+		{
+			//the table's field rooted at the changer has the way to it
+			auto &table = m_changer_tables.at(floor);
+			auto index = std::ranges::find(table.ends, route[i])
+			             - table.ends.begin();
+			std::span<const glm::dvec2> changer_end{&table.positions[index], 1};
+			if (!table.fields.empty())
+			{
+				auto size = table.graph->size();
+				auto sight = sight_from(
+				    floor,
+				    start,
+				    *table.graph,
+				    changer_end,
+				    context.search);
+				reached = table.fields[index].find_path(
+				    start,
+				    sight.first(size),
+				    sight.subspan(size),
+				    context.leg);
+			}
+			else
+			{
+				reached = floor_route(floor, start, changer_end, context);
+			}
+		}
+		if (!reached)
+		{
+			teleport();
+			return;
+		}
+		for (auto &waypoint : context.leg)
+		{
+			result.waypoints.emplace_back(waypoint);
 		}
-		auto attempt = floor_path(option, to, already_seen);
-		if (attempt)
+		if (i != route.size())
 		{
-			attempt->push_back(from);
-			return attempt;
+			auto &changer = floor_changers[route[i] / 2];
+			auto &other = route[i] % 2 ? changer.a : changer.b;
+			result.waypoints.emplace_back(other);
+			floor = other.first;
+			start = other.second;
 		}
 	}
-	return std::nullopt;
 }
+
+Obstacle &World::edit_obstacle(int floor, size_t index)
+{
+	//the caller is free to modify the obstacle, so anything derived from it
+	//can no longer be trusted
+	auto &floor_ref = m_map.at(floor);
+	auto &obstacle = floor_ref.obstacles.at(index);
+	floor_ref.obstacle_changed(index);
+	obstacle.invalidate_geometry();
+	return obstacle;
+}
+
+const Obstacle &World::get_obstacle(int floor, size_t index) const
+{
+	return m_map.at(floor).obstacles.at(index);
+}
+
+void World::set_floor_name(int floor, std::string name)
+{
+	m_map.at(floor).name = name;
+}
+void World::set_floor_group(int floor, std::string group)
+{
+	m_map.at(floor).group = group;
+}
+void World::set_visibility_graph_pruning(int floor, bool enabled)
+{
+	m_map.at(floor).set_visibility_graph_pruning(enabled);
+}
+void World::set_pathing_backend(int floor, PathingBackend backend)
+{
+	m_map.at(floor).pathing_backend = backend;
+}
+
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <array>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include <boost/archive/text_iarchive.hpp>
@@ -11,7 +17,55 @@
 #include <glm/ext.hpp>
 #include <glm/gtx/matrix_transform_2d.hpp>
 
+#include "AStar.hpp"
+#include "FlowField.hpp"
+#include "Landmarks.hpp"
+#include "LineIntersect.hpp"
+#include "LineOfSight.hpp"
+#include "LineOfSightCache.hpp"
+#include "NavMesh.hpp"
+#include "ObstacleGrid.hpp"
+#include "ObstacleStore.hpp"
+#include "PathCache.hpp"
 #include "PathResult.hpp"
+#include "Precision.hpp"
+#include "RoomMap.hpp"
+#include "RouteTable.hpp"
+#include "SegmentKernel.hpp"
+#include "VisibilityGraph.hpp"
+
+//world space data derived from an obstacle's position, size and rotation
+struct ObstacleGeometry
+{
+	//the expands the simulation actually uses, plain, pathing and wandering
+	static constexpr std::array<double, 3> cached_expands{0, 0.011, 0.02};
+
+	std::array<std::array<glm::dvec2, 4>, cached_expands.size()> vertecies;
+	//moves a world space point into the obstacle's unrotated frame
+	glm::dmat4 inverse_rotation;
+	//outwards facing edge normals and the matching plane offsets of the
+	//unexpanded rectangle, only meaningful if has_positive_size
+	std::array<glm::dvec2, 4> edge_normals;
+	std::array<double, 4> edge_offsets;
+	bool has_positive_size;
+
+	const std::array<glm::dvec2, 4> *find_vertecies(double expand) const
+	{
+		for (size_t i = 0; i < cached_expands.size(); i++)
+		{
+			if (cached_expands[i] == expand)
+			{
+				return &vertecies[i];
+			}
+		}
+		return nullptr;
+	}
+	//true if the segment is guaranteed to miss the rectangle expanded by
+	//expand, false means the exact test is needed
+	bool separated(glm::dvec2 from, glm::dvec2 to, double expand) const;
+	//true if the unexpanded rectangle touches the axis aligned box
+	bool overlaps(glm::dvec2 min, glm::dvec2 max) const;
+};
 
 struct Obstacle
 {
@@ -26,6 +80,11 @@ struct Obstacle
 	bool intersects(glm::dvec2 point) const;
 	bool intersects(const Obstacle &other) const;
 
+	//the cached geometry is rebuilt on the next use, this has to be called
+	//whenever position, size or rotation are changed
+	void invalidate_geometry() const { geometry_dirty = true; }
+	const ObstacleGeometry &geometry() const;
+
 	Obstacle() = default;
 	Obstacle(glm::dvec2 position_, glm::dvec2 size_, double rotation_)
 	{
@@ -35,6 +94,12 @@ struct Obstacle
 	}
 
 	private:
+	std::array<glm::dvec2, 4>
+	calculate_vertecies(double expand_by, bool include_rotations) const;
+
+	mutable bool geometry_dirty = true;
+	mutable ObstacleGeometry cached_geometry;
+
 	friend class boost::serialization::access;
 	template <typename Archive>
 	void serialize(Archive &ar, unsigned int)
@@ -51,6 +116,8 @@ struct FloorChanger
 {
 	std::pair<int, glm::dvec2> a, b;
 
+	bool operator==(const FloorChanger &) const = default;
+
 	private:
 	friend class boost::serialization::access;
 	template <typename Archive>
@@ -60,25 +127,236 @@ struct FloorChanger
 	}
 };
 
+//how World::calculate_path finds the way across a floor
+enum class PathingBackend
+{
+	//A* over the visibility graph, the shortest paths
+	visibility_graph,
+	//a corridor through the NavMesh, for floors too big for the visibility
+	//graph, it keeps the whole margin so gaps narrower than twice of it are
+	//closed
+	nav_mesh,
+};
+
+struct VisibilityGraphJob;
+
 struct Floor
 {
 	std::string name;
 	std::string group;
-	std::vector<Obstacle> obstacles;
+	PathingBackend pathing_backend = PathingBackend::visibility_graph;
+	//edit through World or call obstacle_changed afterwards, so the derived
+	//data can follow
+	ObstacleStore obstacles;
 	bool test_line_of_sight(
 	    glm::dvec2 pos_a,
 	    glm::dvec2 pos_b,
 	    bool movement,
 	    bool infection,
 	    double expand = 0) const;
-	const std::vector<std::pair<glm::dvec2, std::vector<size_t>>> &
-	recalc_visibility_graph() const;
-	void recalc() const { needs_recalc = true; }
+	//single precision version for the float simulation build
+	bool test_line_of_sight(
+	    vec2_of<float> pos_a,
+	    vec2_of<float> pos_b,
+	    bool movement,
+	    bool infection,
+	    float expand = 0) const;
+	//out[i] is the result for segments[i], big batches are sorted by grid
+	//cell and split over the shared thread pool
+	void test_line_of_sight_batch(
+	    std::span<const BasicLineSegment<double>> segments,
+	    LineOfSightFlags flags,
+	    std::span<bool> out) const;
+	void test_line_of_sight_batch(
+	    std::span<const BasicLineSegment<float>> segments,
+	    LineOfSightFlags flags,
+	    std::span<bool> out) const;
+	//brings the graph up to date first, the reference stays valid until the
+	//next call
+	const VisibilityGraph &recalc_visibility_graph() const;
+	//the last published graph, after an edit it is rebuilt on the
+	//BackgroundWorker and swapped in by a later call once it is done
+	//waits for a graph matching the obstacles if wait_for_fresh is set or
+	//there never was one
+	std::shared_ptr<const VisibilityGraph>
+	visibility_graph_snapshot(bool wait_for_fresh) const;
+	//true while a background rebuild is running
+	bool rebuilding_visibility_graph() const { return graph_job != nullptr; }
+	//starts that rebuild if the graph is out of date and none is running,
+	//without waiting for it
+	void start_visibility_graph_rebuild() const;
+	//brings everything a path query reads up to date, then keeps the
+	//snapshot and the memos as they are until end_path_batch, so that path
+	//queries can run side by side, see World::calculate_paths
+	void begin_path_batch(bool wait_for_fresh) const;
+	void end_path_batch() const;
+	//as it was last brought up to date, for statistics
+	const VisibilityGraph &get_visibility_graph() const
+	{
+		return *visibility_graph;
+	}
+	void recalc() const
+	{
+		needs_graph_rebuild = true;
+		needs_grid_rebuild = true;
+		invalidate_derived();
+	}
+	//the obstacle with this id was added, moved, resized, rotated or
+	//removed, only that one is reindexed on the next query and only the
+	//visibility graph pairs it could block are tested again
+	void obstacle_changed(size_t id) const
+	{
+		auto slot = ObstacleStore::slot_of(id);
+		if (graph_changes.size() > max_graph_changes)
+		{
+			needs_graph_rebuild = true;
+		}
+		else if (graph_changes.empty() || graph_changes.back() != slot)
+		{
+			graph_changes.push_back(slot);
+		}
+		if (changed_obstacles.size() > obstacles.slot_limit())
+		{
+			needs_grid_rebuild = true;
+		}
+		else if (changed_obstacles.empty() || changed_obstacles.back() != slot)
+		{
+			changed_obstacles.push_back(slot);
+		}
+		invalidate_derived();
+	}
+	//brings the nav mesh up to date first
+	const NavMesh &get_nav_mesh() const;
+	//changes with every edit the visibility graph depends on
+	uint64_t version() const { return graph_version; }
+	//rooms as split by the blocks_infection obstacles, see RoomMap
+	RoomId locate_room(glm::dvec2 point) const;
+	//optional memo of single line of sight results, off by default
+	LineOfSightCache &get_line_of_sight_cache() const
+	{
+		return line_of_sight_cache;
+	}
+	//shared shortest path trees for the ends many paths lead to, off by
+	//default
+	FlowFieldCache &get_flow_fields() const { return flow_fields; }
+	//ALT landmarks for the A* searches on the visibility graph, off by
+	//default
+	LandmarkCache &get_landmarks() const { return landmarks; }
+	//the shortest ways between all vertecies of a small visibility graph,
+	//off by default
+	RouteTableCache &get_route_tables() const { return route_tables; }
+	//keep only the visibility graph edges a shortest path around the
+	//expanded obstacles can use, see Floor::bitangent, off by default
+	//paths no longer cut through the margin around corners, so they can
+	//come out a little longer
+	void set_visibility_graph_pruning(bool enabled)
+	{
+		if (enabled != visibility_graph_pruning)
+		{
+			visibility_graph_pruning = enabled;
+			graph_version++;
+			needs_recalc = true;
+			needs_graph_rebuild = true;
+		}
+	}
+	bool get_visibility_graph_pruning() const
+	{
+		return visibility_graph_pruning;
+	}
 
 	private:
+	template <typename T>
+	bool cached_line_of_sight(
+	    vec2_of<T> from,
+	    vec2_of<T> to,
+	    bool movement,
+	    bool infection,
+	    T expand) const;
+	template <typename T>
+	bool line_of_sight(
+	    vec2_of<T> from,
+	    vec2_of<T> to,
+	    bool movement,
+	    bool infection,
+	    T expand) const;
+	template <typename T>
+	void line_of_sight_batch(
+	    std::span<const BasicLineSegment<T>> segments,
+	    LineOfSightFlags flags,
+	    std::span<bool> out) const;
+	void update_line_of_sight_cache() const;
+	//more changed obstacles than this rebuild the visibility graph, every
+	//pair is tested against each of them
+	static constexpr size_t max_graph_changes = 16;
+
+	static std::vector<size_t> pair_row_chunks(size_t vertex_count);
+	void build_visibility_graph() const;
+	//turns the graph of graph_obstacles into the one of obstacles, see
+	//VisibilityGraphUpdate.cpp
+	void update_visibility_graph() const;
+	//fills convex_corners for the vertecies in visibility_graph, the corners
+	//of movement blocking obstacles not inside another one
+	void find_convex_corners() const;
+	//true if the line through convex corners i and j keeps each of their
+	//obstacles to one side
+	bool bitangent(size_t i, size_t j) const;
+	//false for pairs that are left out of the graph without a test
+	bool keeps_pair(size_t i, size_t j) const
+	{
+		return !visibility_graph_pruning || bitangent(i, j);
+	}
+	//marks everything derived from the obstacles out of date, what recalc
+	//and obstacle_changed have in common, the landmarks and route tables
+	//are rebuilt once they see a new visibility graph
+	void invalidate_derived() const
+	{
+		graph_version++;
+		needs_recalc = true;
+		line_of_sight_cache.clear();
+		flow_fields.clear();
+		needs_room_rebuild = true;
+		needs_nav_mesh_rebuild = true;
+	}
+	//hands the graph work to a copy of the floor on the BackgroundWorker
+	void start_graph_job() const;
+	//takes over the graph of a finished job, if wait is set an unfinished
+	//one is waited for
+	void adopt_graph_job(bool wait) const;
+	template <typename T>
+	const std::vector<BasicPackedObstacle<T>> &packed() const;
+
 	mutable bool needs_recalc = false;
-	mutable std::vector<std::pair<glm::dvec2, std::vector<size_t>>>
-	    visibility_graph;
+	mutable bool needs_grid_rebuild = true;
+	mutable std::vector<size_t> changed_obstacles;
+	mutable ObstacleGrid obstacle_grid;
+	mutable std::vector<PackedObstacle> packed_obstacles;
+	mutable std::vector<BasicPackedObstacle<float>> packed_obstacles_single;
+	mutable LineOfSightCache line_of_sight_cache;
+	mutable FlowFieldCache flow_fields;
+	mutable LandmarkCache landmarks;
+	mutable RouteTableCache route_tables;
+	mutable bool needs_room_rebuild = true;
+	mutable RoomMap room_map;
+	mutable bool needs_nav_mesh_rebuild = true;
+	mutable NavMesh nav_mesh;
+	//replaced by a fresh graph whenever it changes, never edited in place
+	mutable std::shared_ptr<VisibilityGraph> visibility_graph
+	    = std::make_shared<VisibilityGraph>();
+	//the obstacles as they were when visibility_graph was last brought up
+	//to date, and the slots changed since
+	mutable ObstacleStore graph_obstacles;
+	mutable std::vector<size_t> graph_changes;
+	mutable bool needs_graph_rebuild = true;
+	bool visibility_graph_pruning = false;
+	//per visibility_graph vertex while pruning, false for the ones no
+	//shortest path bends at
+	mutable std::vector<bool> convex_corners;
+	//bumped by every change the visibility graph depends on
+	mutable uint64_t graph_version = 0;
+	mutable bool graph_published = false;
+	mutable std::shared_ptr<VisibilityGraphJob> graph_job;
+	//between begin_path_batch and end_path_batch
+	mutable bool in_path_batch = false;
 
 	friend class boost::serialization::access;
 	template <typename Archive>
@@ -86,21 +364,147 @@ struct Floor
 	{
 		ar &name;
 		ar &group;
-		ar &obstacles;
-		ar &needs_recalc;
-		if (!needs_recalc)
+		//saved as a plain list, ids are compacted by a save and load
+		if constexpr (Archive::is_saving::value)
 		{
-			ar &visibility_graph;
+			std::vector<Obstacle> list{obstacles.begin(), obstacles.end()};
+			ar &list;
+		}
+		else
+		{
+			std::vector<Obstacle> list;
+			ar &list;
+			obstacles = ObstacleStore{list};
+			recalc();
+		}
+		//the pruning setting is not saved, so neither is a pruned graph
+		bool graph_outdated = needs_recalc || visibility_graph_pruning;
+		ar &graph_outdated;
+		if constexpr (Archive::is_loading::value)
+		{
+			needs_recalc = graph_outdated;
+		}
+		if (!graph_outdated)
+		{
+			//kept in the adjacency list form older files have
+			if constexpr (Archive::is_saving::value)
+			{
+				auto lists = visibility_graph->adjacency_lists();
+				ar &lists;
+			}
+			else
+			{
+				VisibilityGraph::AdjacencyLists lists;
+				ar &lists;
+				visibility_graph = std::make_shared<VisibilityGraph>(lists);
+				graph_published = true;
+				graph_obstacles = obstacles;
+				graph_changes.clear();
+				needs_graph_rebuild = false;
+			}
 		}
 	}
 };
 
+//a background rebuild of a floor's visibility graph, done is set once
+//floor holds the result
+struct VisibilityGraphJob
+{
+	Floor floor;
+	//the graph_version floor was copied at
+	uint64_t version = 0;
+	std::mutex mutex;
+	std::condition_variable finished;
+	bool done = false;
+};
+
+//the floor changer ends on one floor and the shortest distances between
+//them, routes across floors are found on these instead of by searching
+//every floor, see FloorRouting.cpp
+struct ChangerTable
+{
+	//changer index * 2, + 1 for the b end, and where it is
+	std::vector<size_t> ends;
+	std::vector<glm::dvec2> positions;
+	//what the distances were found on, they are outdated once the floor
+	//has changed
+	uint64_t floor_version = 0;
+	PathingBackend backend = PathingBackend::visibility_graph;
+	std::shared_ptr<const VisibilityGraph> graph;
+	//on visibility graph floors a field rooted at every end, so the way to
+	//an end from anywhere on the floor is quick to find
+	std::vector<FlowField> fields;
+	//distances[i * ends.size() + j] from ends[i] to ends[j], infinite if
+	//there is no way
+	std::vector<double> distances;
+};
+
+//one query of World::calculate_paths
+struct PathQuery
+{
+	int from_floor;
+	glm::dvec2 from;
+	int to_floor;
+	glm::dvec2 to;
+	//filled like calculate_path's, its waypoints keep their capacity
+	PathResult *result;
+};
+
+//the scratch space of a path query, kept for the next one so that a query
+//no bigger than the ones before allocates nothing, every thread has its own
+struct PathSearchContext
+{
+	//AStar's, also the line of sight tests from a point to the vertecies
+	AStar::Buffers search;
+	//the way across the floor at hand
+	std::vector<glm::dvec2> leg;
+	//World::changer_route's, per changer end
+	std::vector<double> from_distances, to_distances, distance;
+	std::vector<std::pair<const ChangerTable *, size_t>> slots;
+	std::vector<size_t> previous;
+	std::vector<std::pair<double, size_t>> open;
+	std::vector<size_t> route;
+	//World::cached_path's, the length of the cached path up to each
+	//waypoint
+	std::vector<double> along;
+};
+
 class World
 {
 	std::unordered_map<int, Floor> m_map;
 
 	std::vector<FloorChanger> floor_changers;
 
+	LineOfSightCache::Settings m_line_of_sight_cache_settings;
+	FlowFieldCache::Settings m_flow_field_settings;
+	LandmarkCache::Settings m_landmark_settings;
+	RouteTableCache::Settings m_route_table_settings;
+	bool m_wait_for_fresh_graphs = false;
+	//calculate_paths', the queries in the order of their keys, and per
+	//query the one with the same key that is solved
+	mutable std::vector<size_t> m_batch_order, m_batch_solver;
+	//set while calculate_paths runs its queries side by side, everything
+	//they share was brought up to date before
+	mutable bool m_in_path_batch = false;
+	//per floor with floor changers, brought up to date by cross floor path
+	//queries and recalc_visibility_graphs
+	mutable std::unordered_map<int, ChangerTable> m_changer_tables;
+	//the changers the tables were made for
+	mutable std::vector<FloorChanger> m_tabled_changers;
+	mutable PathCache m_path_cache;
+
+	//the same cache on every floor, picked by one of Floor's getters
+	template <typename Cache>
+	using FloorCache = Cache &(Floor::*)() const;
+	template <typename Cache>
+	void
+	configure_floors(FloorCache<Cache> cache, typename Cache::Settings settings);
+	//summed over all floors
+	template <typename Cache>
+	typename Cache::Stats floor_stats(FloorCache<Cache> cache) const;
+	template <typename Cache>
+	void reset_floor_stats(FloorCache<Cache> cache);
+
 	public:
 	bool test_line_of_sight(
 	    int floor,
@@ -109,10 +513,51 @@ class World
 	    bool movement,
 	    bool infection,
 	    double expand = 0) const;
+	bool test_line_of_sight(
+	    int floor,
+	    vec2_of<float> pos_a,
+	    vec2_of<float> pos_b,
+	    bool movement,
+	    bool infection,
+	    float expand = 0) const;
+	void test_line_of_sight_batch(
+	    int floor,
+	    std::span<const BasicLineSegment<double>> segments,
+	    LineOfSightFlags flags,
+	    std::span<bool> out) const;
+	void test_line_of_sight_batch(
+	    int floor,
+	    std::span<const BasicLineSegment<float>> segments,
+	    LineOfSightFlags flags,
+	    std::span<bool> out) const;
+
+	RoomId locate_room(int floor, glm::dvec2 point) const;
 
 	PathResult
 	calculate_path(int from_floor, glm::dvec2 from, int to_floor, glm::dvec2 to)
 	    const;
+	//the same into result, its waypoints keep their capacity, so with the
+	//calling thread's PathSearchContext a query like an earlier one
+	//allocates nothing, floors with the NavMesh backend aside
+	//goes through the PathCache while that is enabled
+	void calculate_path(
+	    int from_floor,
+	    glm::dvec2 from,
+	    int to_floor,
+	    glm::dvec2 to,
+	    PathResult &result) const;
+	//calculate_path for every query at once, spread over the ThreadPool
+	//identical queries are solved once, and while the batch runs the
+	//floors' graphs and memos stay as they were when it started, so no
+	//result depends on the number of threads or on which query ran first
+	void calculate_paths(std::span<const PathQuery> queries) const;
+	//brings every floor's visibility graph up to date, floors are rebuilt
+	//concurrently
+	void recalc_visibility_graphs() const;
+	//the same on the BackgroundWorker, returns right away, path queries
+	//use the last published graphs or wait as visibility_graph_snapshot
+	//says until the new ones are done
+	void start_visibility_graph_rebuilds() const;
 
 	FloorChanger &get_floor_changer(size_t index)
 	{
@@ -132,20 +577,155 @@ class World
 		floor_changers.erase(floor_changers.begin() + index);
 	}
 
-	void add_obstacle(int floor, Obstacle);
-	void remove_obstacle(int floor, int obstacle);
-	Obstacle &get_obstacle(int floor, size_t obstacle);
+	//obstacles are addressed by their ObstacleStore id, which stays the same
+	//until the obstacle is removed and is never handed out again, adding
+	//returns the new id
+	std::optional<size_t> add_obstacle(int floor, Obstacle);
+	void remove_obstacle(int floor, size_t obstacle);
 	const Obstacle &get_obstacle(int floor, size_t obstacle) const;
+	//for changing the obstacle, everything derived from it is brought up to
+	//date again, so only call it for an actual edit
+	Obstacle &edit_obstacle(int floor, size_t obstacle);
 	void remove_floor(int floor);
 	void add_floor(int floor);
 	auto get_layout() const -> const decltype(m_map) &;
 	void set_floor_name(int floor, std::string name);
 	void set_floor_group(int floor, std::string group);
+	void set_visibility_graph_pruning(int floor, bool enabled);
+	void set_pathing_backend(int floor, PathingBackend backend);
+	//applies to every floor, including ones added or loaded later
+	void set_line_of_sight_cache_settings(LineOfSightCache::Settings settings);
+	LineOfSightCache::Settings get_line_of_sight_cache_settings() const
+	{
+		return m_line_of_sight_cache_settings;
+	}
+	//summed over all floors
+	LineOfSightCache::Stats get_line_of_sight_cache_stats() const;
+	void reset_line_of_sight_cache_stats();
+	//path queries on the visibility graph to the same ends share a
+	//FlowField once they are frequent, applies to every floor like the line
+	//of sight cache settings
+	void set_flow_field_settings(FlowFieldCache::Settings settings);
+	FlowFieldCache::Settings get_flow_field_settings() const
+	{
+		return m_flow_field_settings;
+	}
+	//summed over all floors
+	FlowFieldCache::Stats get_flow_field_stats() const;
+	void reset_flow_field_stats();
+	//A* searches on the visibility graph bound the distance left with
+	//landmarks, see Landmarks, off by default, applies to every floor like
+	//the line of sight cache settings
+	void set_landmark_settings(LandmarkCache::Settings settings);
+	LandmarkCache::Settings get_landmark_settings() const
+	{
+		return m_landmark_settings;
+	}
+	//summed over all floors
+	LandmarkCache::Stats get_landmark_stats() const;
+	void reset_landmark_stats();
+	//path queries on floors with small visibility graphs read the way
+	//from a RouteTable instead of searching, applies to every floor like
+	//the line of sight cache settings
+	void set_route_table_settings(RouteTableCache::Settings settings);
+	RouteTableCache::Settings get_route_table_settings() const
+	{
+		return m_route_table_settings;
+	}
+	//summed over all floors
+	RouteTableCache::Stats get_route_table_stats() const;
+	void reset_route_table_stats();
+	//path queries between visibility graph floors share the paths between
+	//the vertecies nearest to their start and target, see PathCache, they
+	//only come out longer than planned ones if Settings::max_detour allows
+	void set_path_cache_settings(PathCache::Settings settings)
+	{
+		m_path_cache.configure(settings);
+	}
+	PathCache::Settings get_path_cache_settings() const
+	{
+		return m_path_cache.settings();
+	}
+	PathCache::Stats get_path_cache_stats() const
+	{
+		return m_path_cache.stats();
+	}
+	void reset_path_cache_stats() { m_path_cache.reset_stats(); }
+	//path queries use the last finished visibility graph while a floor's
+	//new one is built in the background, unless this is set
+	void set_wait_for_fresh_graphs(bool wait)
+	{
+		m_wait_for_fresh_graphs = wait;
+	}
+	bool get_wait_for_fresh_graphs() const { return m_wait_for_fresh_graphs; }
 
 	private:
-	std::optional<std::vector<int>> floor_path(int from, int to) const;
-	std::optional<std::vector<int>>
-	floor_path(int from, int to, std::unordered_set<int> &already_seen) const;
+	//the calling thread's
+	static PathSearchContext &search_context();
+	//calculate_path without the PathCache
+	void plan_path(
+	    int from_floor,
+	    glm::dvec2 from,
+	    int to_floor,
+	    glm::dvec2 to,
+	    PathResult &result) const;
+	//calculate_path through the PathCache, the path between the graph
+	//vertecies nearest to from and to is shared through the cache, from
+	//and to join it at the waypoints they see that make it shortest
+	//false if either has no vertex in sight, a floor has no graph or the
+	//path can't be shown to be within PathCache::Settings::max_detour of
+	//the shortest one
+	bool cached_path(
+	    int from_floor,
+	    glm::dvec2 from,
+	    int to_floor,
+	    glm::dvec2 to,
+	    PathResult &result) const;
+	//the vertex of the floor's graph nearest to point that it can see, of
+	//the few nearest ones
+	std::optional<glm::dvec2>
+	snap_to_vertex(int floor, glm::dvec2 point) const;
+	//changes whenever a floor changer does
+	uint64_t changers_hash() const;
+	//the way across a single floor to the nearest of ends into
+	//context.leg, and the index of the end reached
+	std::optional<size_t> floor_route(
+	    int floor,
+	    glm::dvec2 start,
+	    std::span<const glm::dvec2> ends,
+	    PathSearchContext &context) const;
+	//whether point sees each of the graph's vertecies, followed by whether
+	//each of ends sees point, like AStar tests them
+	std::span<const bool> sight_from(
+	    int floor,
+	    glm::dvec2 point,
+	    const VisibilityGraph &graph,
+	    std::span<const glm::dvec2> ends,
+	    AStar::Buffers &buffers) const;
+	//false if a floor or floor changer changed since the tables were made
+	bool changer_tables_current() const;
+	//rebuilds the tables of the floors or floor changers that changed
+	void update_changer_tables() const;
+	//brings the floors and the changer tables up to date and holds them,
+	//and the path cache, as they are until end_path_batch
+	void begin_path_batch() const;
+	void end_path_batch() const;
+	//the length of the shortest way between point and every end of the
+	//floor's table, the same both ways
+	void distances_to_changers(
+	    int floor,
+	    glm::dvec2 point,
+	    std::vector<double> &distances,
+	    PathSearchContext &context) const;
+	//the changers to take from one floor to another into context.route,
+	//each as the index of the end it is entered at, on the shortest route
+	//through the tables, brought up to date first outside of a path batch
+	bool changer_route(
+	    int from_floor,
+	    glm::dvec2 from,
+	    int to_floor,
+	    glm::dvec2 to,
+	    PathSearchContext &context) const;
 
 	friend class boost::serialization::access;
 
@@ -154,15 +734,14 @@ class World
 	{
 		ar &m_map;
 		ar &floor_changers;
+		if constexpr (Archive::is_loading::value)
+		{
+			set_line_of_sight_cache_settings(m_line_of_sight_cache_settings);
+			set_flow_field_settings(m_flow_field_settings);
+			set_landmark_settings(m_landmark_settings);
+			set_route_table_settings(m_route_table_settings);
+			m_changer_tables.clear();
+			m_path_cache.clear();
+		}
 	}
 };
-
-inline bool is_within(double val, double a, double b)
-{
-	constexpr double EPSILON = 0.00001;
-	if (a > b)
-	{
-		std::swap(a, b);
-	}
-	return a - val <= EPSILON && b - val >= -EPSILON;
-}